@@ -0,0 +1,116 @@
+// AnalysisPool.cpp
+
+#include "AnalysisPool.h"
+#include "Jobserver.h"
+
+#include <algorithm>
+
+// How long a worker waits on the jobserver before checking whether there is
+// still work to take a token for
+const int kTokenWaitMs = 50;
+
+// How many results per worker may wait for the writer. A worker that gets
+// this far ahead of it waits, rather than holding every file's dependencies
+// in memory behind one that is slow to analyze.
+const size_t kResultsPerThread = 4;
+
+AnalysisPool::AnalysisPool(const ClassFileAnalyzer& analyzer, int threads, Jobserver* jobserver)
+    : mAnalyzer(analyzer)
+    , mThreadCount(threads < 1 ? 1 : threads)
+    , mJobserver(jobserver)
+    , mWindow(mThreadCount * kResultsPerThread)
+    , mNextFile(0)
+    , mNextResult(0)
+    , mStopping(false)
+{
+}
+
+AnalysisPool::~AnalysisPool()
+{
+    Stop();
+}
+
+void AnalysisPool::Start(const vector<string>& files)
+{
+    mFiles = files;
+    mResults.assign(mWindow, ClassFileAnalyzer::Analysis());
+    mDone.assign(mWindow, false);
+    int threads = std::min<size_t>(mThreadCount, files.size());
+    for (int worker = 0; worker < threads; ++worker)
+        mThreads.push_back(std::thread(&AnalysisPool::work, this, worker));
+}
+
+bool AnalysisPool::claim(size_t& file)
+{
+    std::unique_lock<std::mutex> hold(mLock);
+    while (!mStopping && mNextFile < mFiles.size() && mNextFile - mNextResult >= mWindow)
+        mRoom.wait(hold);
+    if (mStopping || mNextFile == mFiles.size())
+        return false;
+    file = mNextFile++;
+    return true;
+}
+
+void AnalysisPool::work(int worker)
+{
+    // The first worker runs on the token make gave us; others need their own
+    bool token = false;
+    if (worker > 0 && mJobserver)
+    {
+        while (!token)
+        {
+            {
+                std::lock_guard<std::mutex> hold(mLock);
+                if (mStopping || mNextFile == mFiles.size())
+                    return;
+            }
+            token = mJobserver->Acquire(kTokenWaitMs);
+        }
+    }
+
+    ClassFileAnalyzer analyzer(&mAnalyzer);
+    size_t file;
+    while (claim(file))
+    {
+        analyzer.analyzeClassFile(mFiles[file]);
+        {
+            std::lock_guard<std::mutex> hold(mLock);
+            analyzer.SwapAnalysis(mResults[file % mWindow]);
+            mDone[file % mWindow] = true;
+        }
+        mReady.notify_all();
+    }
+
+    if (token)
+        mJobserver->Release();
+}
+
+bool AnalysisPool::Next(ClassFileAnalyzer& analyzer)
+{
+    std::unique_lock<std::mutex> hold(mLock);
+    if (mNextResult == mFiles.size())
+        return false;
+    size_t slot = mNextResult % mWindow;
+    while (!mDone[slot])
+        mReady.wait(hold);
+    analyzer.SwapAnalysis(mResults[slot]);
+    // Drop the analysis the swap left behind before the slot is reused
+    mResults[slot] = ClassFileAnalyzer::Analysis();
+    mDone[slot] = false;
+    ++mNextResult;
+    hold.unlock();
+    mRoom.notify_one();
+    return true;
+}
+
+void AnalysisPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> hold(mLock);
+        mStopping = true;
+    }
+    mRoom.notify_all();
+    for (size_t i = 0; i < mThreads.size(); ++i)
+        mThreads[i].join();
+    mThreads.clear();
+}
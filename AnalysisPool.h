@@ -0,0 +1,63 @@
+// AnalysisPool.h
+
+#pragma once
+
+#include "ClassFileAnalyzer.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+class Jobserver;
+
+// Analyzes class files on worker threads, each with its own analyzer, and
+// hands the results back one at a time in the order the files were given, so
+// that whatever writes them sees exactly what a single thread would. Workers
+// run at most a few results per thread ahead of the one handed back next.
+class AnalysisPool
+{
+public:
+    AnalysisPool(const ClassFileAnalyzer& analyzer, int threads, Jobserver* jobserver);
+    // Runs at most threads workers for analyzer, whose class path must be
+    // indexed before Start. With a jobserver, every worker but the first
+    // runs only while it holds a token from it.
+
+    ~AnalysisPool();
+
+    void Start(const vector<string>& files);
+
+    bool Next(ClassFileAnalyzer& analyzer);
+    // Waits for the next file's analysis and swaps it into analyzer, as if
+    // analyzer had analyzed it; its Error() tells if that failed. Returns
+    // false once every file has been handed back.
+
+    void Stop();
+    // Abandons the files not yet analyzed and waits for the workers to
+    // finish, which gives back their tokens. Next must not be called after.
+
+private:
+    void work(int worker);
+    bool claim(size_t& file);
+
+private:
+    const ClassFileAnalyzer& mAnalyzer;
+    int                      mThreadCount;
+    Jobserver*               mJobserver;
+    size_t                   mWindow;   // results that may wait to be handed back
+
+    vector<string>                    mFiles;
+    vector<ClassFileAnalyzer::Analysis> mResults;     // file i's is at i % mWindow
+    vector<bool>                      mDone;
+    size_t                            mNextFile;      // next to analyze
+    size_t                            mNextResult;    // next to hand back
+    bool                              mStopping;
+    std::mutex                        mLock;
+    std::condition_variable           mReady;         // a result is done
+    std::condition_variable           mRoom;          // a result was handed back
+    vector<std::thread>               mThreads;
+};
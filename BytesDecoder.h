@@ -13,8 +13,12 @@ public:
 
     uint16_t DecodeWord();
 
+    bool Ok() const { return !mOverrun; }
+    // False once a decode has run off the end of the bytes. Such decodes
+    // return zero rather than reading past the limit.
+
 private:
     const uint8_t* mCursor;
     const uint8_t* mLimit;
+    bool mOverrun;
 };
-
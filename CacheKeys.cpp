@@ -0,0 +1,72 @@
+// CacheKeys.cpp
+
+#include "CacheKeys.h"
+
+#include <algorithm>
+
+struct MemberOrder
+{
+    const vector<uint32_t>& rank;
+
+    MemberOrder(const vector<uint32_t>& _rank) : rank(_rank) {}
+
+    bool operator()(CacheKeys::NodeId a, CacheKeys::NodeId b) const
+    {
+        return rank[a] < rank[b];
+    }
+};
+
+CacheKeys::CacheKeys(const DependencyGraph& graph, const vector<Sha256::Digest>& contents)
+    : mKeys(graph.NodeCount())
+{
+    vector<uint32_t> component;
+    size_t count = graph.StronglyConnectedComponents(component);
+    vector<vector<NodeId> > members(count);
+    for (NodeId node = 0; node < graph.NodeCount(); ++node)
+        members[component[node]].push_back(node);
+    vector<uint32_t> rank;
+    graph.NameRanks(rank);
+
+    // Components are numbered dependencies first, so every key a component
+    // needs is ready by the time it is reached. Everything is hashed in an
+    // order that depends only on names and content, never on node ids.
+    vector<Sha256::Digest> componentKeys(count);
+    vector<Sha256::Digest> depKeys;
+    for (uint32_t c = 0; c < count; ++c)
+    {
+        vector<NodeId>& group = members[c];
+        std::sort(group.begin(), group.end(), MemberOrder(rank));
+
+        depKeys.clear();
+        for (size_t i = 0; i < group.size(); ++i)
+        {
+            const vector<NodeId>& deps = graph.Deps(group[i]);
+            for (size_t d = 0; d < deps.size(); ++d)
+            {
+                if (component[deps[d]] != c)
+                    depKeys.push_back(componentKeys[component[deps[d]]]);
+            }
+        }
+        std::sort(depKeys.begin(), depKeys.end());
+        depKeys.erase(std::unique(depKeys.begin(), depKeys.end()), depKeys.end());
+
+        Sha256 hash;
+        for (size_t i = 0; i < group.size(); ++i)
+        {
+            hash.Update(graph.Name(group[i]));
+            hash.Update("", 1);
+            hash.Update(contents[group[i]]);
+        }
+        for (size_t i = 0; i < depKeys.size(); ++i)
+            hash.Update(depKeys[i]);
+        componentKeys[c] = hash.Finish();
+
+        for (size_t i = 0; i < group.size(); ++i)
+        {
+            Sha256 member;
+            member.Update(componentKeys[c]);
+            member.Update(graph.Name(group[i]));
+            mKeys[group[i]] = member.Finish();
+        }
+    }
+}
@@ -0,0 +1,25 @@
+// CacheKeys.h
+
+#pragma once
+
+#include "DependencyGraph.h"
+#include "Sha256.h"
+
+// Content-addressed build cache keys, Merkle style: a class's key hashes its
+// own content with the keys of everything it depends on, so it changes when
+// anything in its transitive closure does. Classes in a dependency cycle
+// cannot be hashed one after another, so each strongly connected component
+// is hashed whole, and its members' keys derive from that.
+class CacheKeys
+{
+public:
+    typedef DependencyGraph::NodeId NodeId;
+
+    CacheKeys(const DependencyGraph& graph, const vector<Sha256::Digest>& contents);
+    // contents holds the content hash of each node, by node id.
+
+    const Sha256::Digest& Key(NodeId node) const { return mKeys[node]; }
+
+private:
+    vector<Sha256::Digest> mKeys;
+};
@@ -3,25 +3,82 @@
 #include "ClassFile.h"
 
 #include "BytesDecoder.h"
-#include "ClassFileAnalyzer.h"
+#include "ClassFileVisitor.h"
 #include "FileReader.h"
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 ClassFile::ClassFile(const char* infilename)
     : mConstantPoolCount(0)
     , mConstantPool(0)
+    , mThisClass(0)
     , mAttributes(0)
 {
     FileReader reader(infilename);
+    read(reader, infilename);
+}
+
+ClassFile::ClassFile(const char* name, const uint8_t* bytes, size_t length)
+    : mConstantPoolCount(0)
+    , mConstantPool(0)
+    , mThisClass(0)
+    , mAttributes(0)
+{
+    FileReader reader(bytes, length, name);
+    read(reader, name);
+}
+
+ClassFile::~ClassFile()
+{
+    for (int i = 0; i < mConstantPoolCount; ++i)
+    {
+        cp_info* cp = mConstantPool[i];
+        if (cp && cp->tag == CONSTANT_Utf8)
+        {
+            free(((constant_utf8_info*) cp)->str);
+            delete (constant_utf8_info*) cp;
+        }
+        else if (cp)
+            delete (constant_class_info*) cp;
+    }
+    delete [] mConstantPool;
+
+    while (mAttributes)
+    {
+        attribute_info* next = mAttributes->next;
+        free(mAttributes->info);
+        delete mAttributes;
+        mAttributes = next;
+    }
+
+    for (size_t i = 0; i < mDescriptorNames.size(); ++i)
+        free(mDescriptorNames[i]);
+}
+
+void ClassFile::read(FileReader& reader, const char* infilename)
+{
+    if (!reader.Ok())
+    {
+        mError = reader.Error();
+        return;
+    }
 
-    reader.ReadLong(); // magic
+    uint32_t magic = reader.ReadLong();
+    if (magic != 0xCAFEBABE)
+    {
+        mError = std::string(infilename) + " is not a class file";
+        return;
+    }
     reader.ReadWord(); // minor_version
     reader.ReadWord(); // major_version
     mConstantPoolCount = reader.ReadWord();
     mConstantPool = readConstantPool(reader, infilename, mConstantPoolCount);
+    if (!Ok())
+        return;
     reader.ReadWord(); // access_flags
-    reader.ReadWord(); // this_class
+    mThisClass = reader.ReadWord(); // this_class
     reader.ReadWord(); // super_class
     uint16_t interfaces_count = reader.ReadWord();
     skipWordArray(reader, interfaces_count); // interfaces
@@ -31,6 +88,9 @@ ClassFile::ClassFile(const char* infilename)
     mAttributes = readMethods(reader, methods_count, mAttributes); // methods
     uint16_t attributes_count = reader.ReadWord();
     mAttributes = readAttributes(reader, attributes_count, mAttributes);
+
+    if (!reader.Ok())
+        mError = reader.Error();
 }
 
 attribute_info* ClassFile::readAttributeInfo(FileReader& reader, attribute_info* atts)
@@ -49,21 +109,24 @@ attribute_info* ClassFile::readAttributes(FileReader& reader, int count, attribu
     return atts;
 }
 
-void ClassFile::scanAnnotation(BytesDecoder& decoder, ClassFileAnalyzer& analyzer)
+void ClassFile::scanAnnotation(BytesDecoder& decoder, ClassFileVisitor& visitor,
+                               bool topLevel, bool visible)
 {
     int type_index = decoder.DecodeWord();
     const char* name = getClassName(type_index);
-    if (analyzer.isIncludedClass(name))
-        analyzer.addDep(name);
+    if (name && topLevel)
+        visitor.visitClassAnnotation(name);
+    if (name && visible)
+        visitor.visitAnnotation(name);
     int num_element_value_pairs = decoder.DecodeWord();
-    for (int i = 0; i < num_element_value_pairs; ++i)
+    for (int i = 0; i < num_element_value_pairs && decoder.Ok(); ++i)
     {
         decoder.DecodeWord(); // skip over element_name_index
-        scanElementValue(decoder, analyzer);
+        scanElementValue(decoder, visitor, visible);
     }
 }
 
-void ClassFile::scanElementValue(BytesDecoder& decoder, ClassFileAnalyzer& analyzer)
+void ClassFile::scanElementValue(BytesDecoder& decoder, ClassFileVisitor& visitor, bool visible)
 {
     uint8_t tag = decoder.DecodeByte();
     switch (tag)
@@ -95,21 +158,21 @@ void ClassFile::scanElementValue(BytesDecoder& decoder, ClassFileAnalyzer& analy
             int type_name_index = decoder.DecodeWord();
             const char* name = getClassName(type_name_index);
             decoder.DecodeWord(); // skip over const_name_index
-            if (analyzer.isIncludedClass(name))
-                analyzer.addDep(name);
+            if (name && visible)
+                visitor.visitAnnotation(name);
             break;
         }
         case '@':
         {
-            scanAnnotation(decoder, analyzer);
+            scanAnnotation(decoder, visitor, false, visible);
             break;
         }
         case '[':
         {
             int num_values = decoder.DecodeWord();
             int i;
-            for (i = 0; i < num_values; ++i)
-                scanElementValue(decoder, analyzer);
+            for (i = 0; i < num_values && decoder.Ok(); ++i)
+                scanElementValue(decoder, visitor, visible);
             break;
         }
         default:
@@ -117,48 +180,44 @@ void ClassFile::scanElementValue(BytesDecoder& decoder, ClassFileAnalyzer& analy
     }
 }
 
-void ClassFile::findDepsInFile(const char* target, ClassFileAnalyzer& analyzer)
+void ClassFile::findDepsInFile(const char* target, ClassFileVisitor& visitor)
 {
+    if (!Ok())
+        return;
+
     for (int i=0; i < mConstantPoolCount; ++i)
     {
         cp_info* cp = mConstantPool[i];
         if (cp && cp->tag == CONSTANT_Class)
         {
             const char* name = getClassName(i);
-            if (analyzer.isIncludedClass(name))
+            if (name && name[0] != '[')   /* Skip array classes */
             {
-                if (name[0] != '[')   /* Skip array classes */
+                char* dollar = (char*) strchr(name, '$');
+                if (dollar)
                 {
-                    char* dollar = index(name, '$');
-                    if (dollar)
+                    /* It's an inner class */
+                    if (strncmp(name, target, dollar-name) == 0)
                     {
-                        /* It's an inner class */
-                        if (strncmp(name, target, dollar-name) == 0)
-                        {
-                            /* It's one of target's inner classes, so we
-                               depend on whatever *it* depends on and thus
-                               we need to recurse. */
-                            bool added = analyzer.addDep(name);
-                            if (added)
-                            {
-                                analyzer.findDeps(name);    // Recurses here!!
-                            }
-                        }
-                        else
-                        {
-                            /* It's somebody else's inner class, so we
-                               depend on its outer class source file */
-                            *dollar = '\0';
-                            analyzer.addDep(name);
-                            *dollar = '$';
-                        }
+                        /* It's one of target's inner classes, so we
+                           depend on whatever *it* depends on and the
+                           visitor needs to recurse. */
+                        visitor.visitInnerClass(name);
                     }
                     else
                     {
-                        /* It's a regular class */
-                        analyzer.addDep(name);
+                        /* It's somebody else's inner class, so we
+                           depend on its outer class source file */
+                        *dollar = '\0';
+                        visitor.visitDependency(name);
+                        *dollar = '$';
                     }
                 }
+                else
+                {
+                    /* It's a regular class */
+                    visitor.visitDependency(name);
+                }
             }
         }
     }
@@ -167,13 +226,16 @@ void ClassFile::findDepsInFile(const char* target, ClassFileAnalyzer& analyzer)
     while (att != NULL)
     {
         const char* name = getString(att->attribute_name_index);
-        if (strcmp(name, "RuntimeVisibleAnnotations") == 0)
+        bool visible = name && strcmp(name, "RuntimeVisibleAnnotations") == 0;
+        if (visible || (name && strcmp(name, "RuntimeInvisibleAnnotations") == 0))
         {
+            /* Only visible annotations are dependencies, but the class's
+               own annotations are reported from both. */
             int i;
             BytesDecoder decoder(att->info, att->attribute_length);
             int num_annotations = decoder.DecodeWord();
-            for (i = 0; i < num_annotations; ++i)
-                scanAnnotation(decoder, analyzer);
+            for (i = 0; i < num_annotations && decoder.Ok(); ++i)
+                scanAnnotation(decoder, visitor, true, visible);
         }
         att = att->next;
     }
@@ -183,14 +245,16 @@ cp_info** ClassFile::readConstantPool(FileReader& reader, const char* filename,
 {
     cp_info** result = new cp_info*[count];
     int i;
-    result[0] = NULL;
-    for (i=1; i<count; ++i)
+    for (i=0; i<count; ++i)
+        result[i] = NULL;
+    for (i=1; i<count && Ok(); ++i)
     {
         result[i] = readConstantPoolInfo(reader, filename);
         if (result[i] == kLongTag)
         {
             result[i] = NULL;
-            result[++i] = NULL;
+            if (i+1 < count)
+                result[++i] = NULL;
         }
     }
     return result;
@@ -265,9 +329,16 @@ cp_info* ClassFile::readConstantPoolInfo(FileReader& reader, const char* filenam
         }
         default:
         {
-            fprintf(stderr, "invalid constant pool tag %d in %s\n", tag,
-                    filename);
-            exit(1);
+            if (!reader.Ok())
+            {
+                mError = reader.Error();
+                return NULL;
+            }
+            char message[1000];
+            snprintf(message, sizeof(message), "invalid constant pool tag %d in %s", tag,
+                     filename);
+            mError = message;
+            return NULL;
         }
     }
     return NULL;
@@ -314,9 +385,10 @@ void ClassFile::skipWordArray(FileReader& reader, int length)
 
 const char* ClassFile::getString(int index) const
 {
+    if (index <= 0 || index >= mConstantPoolCount)
+        return NULL;
     cp_info* cp = mConstantPool[index];
-    cp = mConstantPool[index];
-    if (cp->tag == CONSTANT_Utf8)
+    if (cp && cp->tag == CONSTANT_Utf8)
     {
         const char* name = ((constant_utf8_info*) cp)->str;
         return name;
@@ -324,8 +396,20 @@ const char* ClassFile::getString(int index) const
     return NULL;
 }
 
-const char* ClassFile::getClassName(int index) const
+const char* ClassFile::Name() const
+{
+    if (mThisClass == 0 || mThisClass >= mConstantPoolCount)
+        return NULL;
+    cp_info* cp = mConstantPool[mThisClass];
+    if (cp == NULL || cp->tag != CONSTANT_Class)
+        return NULL;
+    return getString(((constant_class_info*) cp)->name_index);
+}
+
+const char* ClassFile::getClassName(int index)
 {
+    if (index <= 0 || index >= mConstantPoolCount)
+        return NULL;
     cp_info* cp = mConstantPool[index];
     if (cp == NULL)
         return NULL;
@@ -350,6 +434,7 @@ const char* ClassFile::getClassName(int index) const
                 }
                 ++s;
             }
+            mDescriptorNames.push_back(result);
             return result;
         }
     }
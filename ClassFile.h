@@ -3,6 +3,10 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+#include <vector>
 
 #define CONSTANT_Class                   7
 #define CONSTANT_Double                  6
@@ -57,22 +61,42 @@ struct attribute_info
 
 class BytesDecoder;
 class FileReader;
-class ClassFileAnalyzer;
+class ClassFileVisitor;
 
 class ClassFile
 {
 public:
     ClassFile(const char* filename);
+    ClassFile(const char* name, const uint8_t* bytes, size_t length);
+    ~ClassFile();
+
+    bool Ok() const { return mError.empty(); }
+    const std::string& Error() const { return mError; }
+    // A file that could not be read or parsed reports why here, and visits
+    // nothing.
 
-    void findDepsInFile(const char* target, ClassFileAnalyzer& analyzer);
+    const char* Name() const;
+    // The name of the class this file holds, from its this_class entry.
 
-    void scanAnnotation(BytesDecoder& decoder, ClassFileAnalyzer& analyzer);
-    void scanElementValue(BytesDecoder& decoder, ClassFileAnalyzer& analyzer);
+    void findDepsInFile(const char* target, ClassFileVisitor& visitor);
+    // Reports the dependencies of target, the class this file holds, to
+    // visitor.
+
+    void scanAnnotation(BytesDecoder& decoder, ClassFileVisitor& visitor,
+                        bool topLevel, bool visible);
+    void scanElementValue(BytesDecoder& decoder, ClassFileVisitor& visitor, bool visible);
+    // topLevel is set for an annotation on the class itself, rather than one
+    // nested in another's element values; visible for one in
+    // RuntimeVisibleAnnotations, whose types are dependencies.
 
 private:
+    ClassFile(const ClassFile&);
+    void operator=(const ClassFile&);
+
+    void read(FileReader& reader, const char* filename);
 
     const char* getString(int index) const;
-    const char* getClassName(int index) const;
+    const char* getClassName(int index);
     cp_info** readConstantPool(FileReader& reader, const char* filename, int count);
     cp_info*  readConstantPoolInfo(FileReader& reader, const char* filename);
     attribute_info* readFields(FileReader& reader, int count, attribute_info* atts);
@@ -87,6 +111,9 @@ private:
 private:
     uint16_t mConstantPoolCount;
     cp_info** mConstantPool;
+    uint16_t mThisClass;
     attribute_info* mAttributes;
+    std::vector<char*> mDescriptorNames;   // class names cut out of descriptors
+    std::string mError;
 };
 
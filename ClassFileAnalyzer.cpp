@@ -1,170 +1,604 @@
 // ClassFileAnalyzer.cpp
 
 #include "ClassFileAnalyzer.h"
+#include "CacheKeys.h"
 #include "ClassFile.h"
+#include "DependencyDatabase.h"
+#include "DependencyGraph.h"
+#include "ExternalGraph.h"
+#include "FilePath.h"
+#include "PackageGraph.h"
+#include "TraceLog.h"
 
-#include <assert.h>
+#include <algorithm>
+#include <iterator>
+#include <map>
 #include <stdio.h>
 #include <stdlib.h>
-#include <dirent.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
 #include <sys/stat.h>
 
-FILE* fopenPath(char* path);
-bool mkdirPath(char* path);
+const string gDepFormat("d");
+const string gTabFormat("tab");
+const string gBinFormat("bin");
+const string gClassSuffix(".class");
 
-FILE* fopenPath(char* path)
+ClassFileAnalyzer::ClassFileAnalyzer()
+    : mJavaPath(".java")
+    , mClassPath(".class")
+    , mShared(0)
+    , mOutFile(0)
+    , mGraph(0)
+    , mDatabase(0)
+    , mShardIndex(0)
+    , mShardCount(1)
+    , mTrace(0)
+    , mTraceLog(0)
+    , mTraceEvents(0)
+    , mVisitor(0)
+    , mClassBytes(0)
+    , mRoot(false)
 {
-    char* end = rindex(path, '/');
-    if (end)
-    {
-        *end = '\0';
-        mkdirPath(path);
-        *end = '/';
-    }
-    return fopen(path, "w");
+    mFormat.assign(gDepFormat);
+    mMergeOutput = false;
 }
 
-bool mkdirPath(char* path)
+ClassFileAnalyzer::ClassFileAnalyzer(const ClassFileAnalyzer* shared)
+    : mExcludedPackages(shared->mExcludedPackages)
+    , mIncludedPackages(shared->mIncludedPackages)
+    , mRootAnnotations(shared->mRootAnnotations)
+    , mJavaPath(".java")
+    , mClassPath(".class")
+    , mShared(shared)
+    , mFormat(shared->mFormat)
+    , mMergeOutput(false)
+    , mOutFile(0)
+    , mGraph(0)
+    , mDatabase(0)
+    , mShardIndex(0)
+    , mShardCount(1)
+    , mTrace(shared->mTrace)
+    , mTraceLog(shared->mTraceLog)
+    , mTraceEvents(mTraceLog ? mTraceLog->NewBuffer() : 0)
+    , mVisitor(0)
+    , mClassBytes(0)
+    , mRoot(false)
 {
-    char* slashptr = path;
-    DIR* dyr;
+}
 
-    while ((slashptr = strchr(slashptr + 1, '/')))
-    {
-        *slashptr = '\0';
-        dyr = opendir(path);
-        if (dyr)
-            closedir(dyr);
-        else if (mkdir(path, S_IRWXU) < 0)
-        {
-            *slashptr = '/';
-            return true;
-        }
-        *slashptr = '/';
-        if (slashptr[1] == '\0')
-        {
-            /* Just ignore a trailing slash */
-            return false;
-        }
-    }
-    if (mkdir(path, S_IRWXU) < 0)
-        return true;
-    else
-        return false;
+ClassFileAnalyzer::~ClassFileAnalyzer()
+{
+    if (mOutFile && mOutFile != stdout)
+        fclose(mOutFile);
+    delete mGraph;
+    delete mDatabase;
 }
 
-const string gDepFormat("d");
-const string gTabFormat("tab");
+void ClassFileAnalyzer::SetTraceLog(TraceLog* log)
+{
+    mTraceLog = log;
+    mTraceEvents = log->NewBuffer();
+}
 
-ClassFileAnalyzer::ClassFileAnalyzer()
+bool ClassFileAnalyzer::addRoots(ClassPath& path, const string& roots)
 {
-    mFormat.assign(gDepFormat);
-    mMergeOutput = false;
+    if (path.AddRoots(roots))
+        return true;
+    mError = path.Error();
+    return false;
 }
 
-void ClassFileAnalyzer::SetFormat(const string& format)
+void ClassFileAnalyzer::IndexClassPath()
+{
+    mClassPath.BuildIndex();
+    mJavaPath.BuildIndex();
+}
+
+bool ClassFileAnalyzer::SetFormat(const string& format)
 {
     if (format == gDepFormat)
         mFormat.assign(format);
     else if (format == gTabFormat)
         mFormat.assign(format);
+    else if (format == gBinFormat)
+        mFormat.assign(format);
     else
+        return false;
+    return true;
+}
+
+bool ClassFileAnalyzer::SetShard(int index, int count)
+{
+    if (count < 1 || index < 0 || index >= count)
+        return false;
+    mShardIndex = index;
+    mShardCount = count;
+    return true;
+}
+
+bool ClassFileAnalyzer::InShard(const string& fullClassPath) const
+{
+    if (mShardCount == 1)
+        return true;
+    return ShardOf(PackageAndNameOf(fullClassPath), mShardCount) == mShardIndex;
+}
+
+string ClassFileAnalyzer::PackageAndNameOf(const string& fullClassPath) const
+{
+    return FullClassPathToPackageAndName(WithClassSuffix(fullClassPath));
+}
+
+int ClassFileAnalyzer::ShardOf(const string& packageAndName, int count)
+{
+    // FNV-1a over the outer class name, so that inner classes land in the
+    // same shard as their outer class whatever the platform's hashing.
+    size_t len = packageAndName.find('$');
+    if (len == string::npos)
+        len = packageAndName.size();
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; ++i)
     {
-        fprintf(stderr, "Format %s unrecognized.\n", format.c_str());
-        exit(1);
+        hash ^= (uint8_t) packageAndName[i];
+        hash *= 1099511628211ULL;
     }
+    return hash % count;
+}
+
+bool ClassFileAnalyzer::openMergedOutput()
+{
+    if (mOutFile)
+        return true;
+    if (mOutputPath.empty())
+    {
+        mOutFile = stdout;
+        return true;
+    }
+    mOutFile = fopen(mOutputPath.c_str(), "wb");
+    if (!mOutFile)
+    {
+        mError = "unable to open output file " + mOutputPath;
+        return false;
+    }
+    return true;
 }
 
-void ClassFileAnalyzer::WriteOutput() const
+void ClassFileAnalyzer::SwapAnalysis(Analysis& analysis)
 {
+    mClassFilePath.swap(analysis.classFilePath);
+    mPackageAndName.swap(analysis.packageAndName);
+    mDeps.swap(analysis.deps);
+    std::swap(mClassBytes, analysis.classBytes);
+    std::swap(mRoot, analysis.root);
+    mError.swap(analysis.error);
+}
+
+bool ClassFileAnalyzer::SetDatabase(const string& scope)
+{
+    if (scope != "package" && scope != "tree")
+        return false;
+    mDatabaseScope = scope;
+    return true;
+}
+
+string ClassFileAnalyzer::databasePath(const string& packageAndName) const
+{
+    // Hyphens keep fragment names apart from any class's output file
+    if (mDatabaseScope == "tree")
+        return mDepRoot + "jdep-tree." + mFormat;
+    size_t slash = packageAndName.rfind('/');
+    string package = slash == string::npos ? "" : packageAndName.substr(0, slash + 1);
+    return mDepRoot + package + "jdep-package." + mFormat;
+}
+
+DependencyDatabase& ClassFileAnalyzer::database()
+{
+    if (!mDatabase)
+        mDatabase = new DependencyDatabase(mFormat == gTabFormat);
+    return *mDatabase;
+}
+
+bool ClassFileAnalyzer::WriteOutput()
+{
+    if (mFormat == gBinFormat)
+    {
+        // The binary format is a single graph, written by FinishOutput
+        if (!mGraph)
+            mGraph = new DependencyGraph;
+        AddToGraph(*mGraph);
+        return true;
+    }
+
+    TraceSpan write(mTraceEvents, TraceBuffer::kWrite, mPackageAndName);
+    string text = mFormat == gDepFormat ? formatDependencyFile() : formatTabularOutput();
+    write.SetSize(text.size());
+    if (!mDatabaseScope.empty())
+    {
+        // Held until FinishOutput saves the fragments that changed
+        if (database().SetEntry(databasePath(mPackageAndName), mPackageAndName, text))
+            return true;
+        mError = mDatabase->Error();
+        return false;
+    }
+
     FILE* outFile = 0;
     if (mMergeOutput)
-        outFile = stdout;
+    {
+        if (!openMergedOutput())
+            return false;
+        outFile = mOutFile;
+    }
     else
     {
-        const char* name = mPackageAndName.c_str();
-        char outfilename[1000];
-        snprintf(outfilename, sizeof(outfilename), "%s%s.%s", mDepRoot.c_str(), name, mFormat.c_str());
-        outFile = fopenPath(outfilename);
+        string path = outputPath(mPackageAndName, mFormat.c_str());
+        outFile = fopenPath(&path[0]);
         if (!outFile)
         {
-            fprintf(stderr, "unable to open output file %s", outfilename);
-            exit(1);
+            mError = "unable to open output file " + path;
+            return false;
         }
     }
 
-    if (mFormat == gDepFormat)
-        WriteDependencyFile(outFile);
-    else if (mFormat == gTabFormat)
-        WriteTabularOutput(outFile);
+    fwrite(text.data(), 1, text.size(), outFile);
 
     if (!mMergeOutput)
         fclose(outFile);
+    return true;
+}
+
+bool ClassFileAnalyzer::RemoveOutput(const string& packageAndName)
+{
+    if (!mDatabaseScope.empty())
+    {
+        if (database().RemoveEntry(databasePath(packageAndName), packageAndName))
+            return true;
+        mError = mDatabase->Error();
+        return false;
+    }
+    string path = OutputPath(packageAndName);
+    if (unlink(path.c_str()) != 0 && errno != ENOENT)
+    {
+        mError = "unable to remove output file " + path;
+        return false;
+    }
+    return true;
+}
+
+bool ClassFileAnalyzer::OutputDelta(vector<string>& removed, vector<string>& added)
+{
+    set<string> before, after;
+    if (!readOutputEntries(outputPath(mPackageAndName, mFormat.c_str()), before))
+        return false;
+    outputEntries(after);
+    removed.clear();
+    added.clear();
+    std::set_difference(before.begin(), before.end(), after.begin(), after.end(),
+                        std::back_inserter(removed));
+    std::set_difference(after.begin(), after.end(), before.begin(), before.end(),
+                        std::back_inserter(added));
+    return true;
+}
+
+void ClassFileAnalyzer::outputEntries(set<string>& entries) const
+{
+    // What formatDependencyFile or formatTabularOutput would list
+    for (StringSet::iterator it=mDeps.begin(); it!=mDeps.end(); ++it)
+    {
+        if (it->find('$') != string::npos)
+            continue;
+        entries.insert(mFormat == gDepFormat ? mJavaPath.PathFor(*it) : *it);
+    }
+}
+
+bool ClassFileAnalyzer::readOutputEntries(const string& path, set<string>& entries)
+{
+    FILE* inFile = fopen(path.c_str(), "r");
+    if (!inFile)
+    {
+        if (errno == ENOENT)
+            return true;
+        mError = "unable to open output file " + path;
+        return false;
+    }
+
+    // A d file is the rule's target line, then one "  entry \" line per
+    // dependency; a tab file is one "class<TAB>entry" line per dependency.
+    char line[10000];
+    bool first = true;
+    while (fgets(line, sizeof(line), inFile))
+    {
+        string entry(line);
+        if (!entry.empty() && entry[entry.size()-1] == '\n')
+            entry.resize(entry.size() - 1);
+        if (mFormat == gDepFormat)
+        {
+            bool target = first;
+            first = false;
+            if (target || entry.size() < 4)
+                continue;
+            entry = entry.substr(2, entry.size() - 4);
+        }
+        else
+        {
+            size_t tab = entry.find('\t');
+            if (tab == string::npos)
+                continue;
+            entry.erase(0, tab + 1);
+        }
+        entries.insert(entry);
+    }
+    bool ok = !ferror(inFile);
+    fclose(inFile);
+    if (!ok)
+        mError = "error reading output file " + path;
+    return ok;
+}
+
+bool ClassFileAnalyzer::WritesPerClassFiles() const
+{
+    return !mMergeOutput && mFormat != gBinFormat;
+}
+
+string ClassFileAnalyzer::outputPath(const string& packageAndName, const char* suffix) const
+{
+    return mDepRoot + packageAndName + "." + suffix;
+}
+
+void ClassFileAnalyzer::AddToGraph(GraphSink& graph) const
+{
+    StringSet deps;
+    for (StringSet::iterator it=mDeps.begin(); it!=mDeps.end(); ++it)
+    {
+        if (it->find('$') == string::npos)
+            deps.insert(*it);
+    }
+    graph.AddClass(mPackageAndName, deps, mClassBytes);
+}
+
+// Collects the inner classes of outer that a class file names as its own
+class InnerClassCollector : public ClassFileVisitor
+{
+public:
+    InnerClassCollector(const string& outer, set<string>& names)
+        : mPrefix(outer + "$")
+        , mNames(names)
+    {}
+
+    virtual void visitDependency(const char*) {}
+    virtual void visitAnnotation(const char*) {}
+    virtual void visitInnerClass(const char* name)
+    {
+        if (strncmp(name, mPrefix.c_str(), mPrefix.size()) == 0)
+            mNames.insert(name);
+    }
+
+private:
+    string       mPrefix;
+    set<string>& mNames;
+};
+
+bool ClassFileAnalyzer::ReadContent(const string& packageAndName, vector<uint8_t>& bytes) const
+{
+    if (mJavaPath.ReadFile(packageAndName, bytes))
+        return true;
+    if (!mClassPath.ReadFile(packageAndName, bytes))
+        return false;
+
+    // javac writes each inner class to its own file, which can change while
+    // the outer class's file does not, so they are all part of its content
+    set<string> found;
+    InnerClassCollector collector(packageAndName, found);
+    ClassFile(packageAndName.c_str(), bytes.data(), bytes.size())
+        .findDepsInFile(packageAndName.c_str(), collector);
+    map<string, vector<uint8_t> > inners;
+    while (!found.empty())
+    {
+        string name = *found.begin();
+        found.erase(found.begin());
+        if (inners.count(name))
+            continue;
+        vector<uint8_t>& inner = inners[name];
+        if (mClassPath.ReadFile(name, inner))
+            ClassFile(name.c_str(), inner.data(), inner.size()).findDepsInFile(name.c_str(), collector);
+    }
+    for (map<string, vector<uint8_t> >::iterator it = inners.begin(); it != inners.end(); ++it)
+        bytes.insert(bytes.end(), it->second.begin(), it->second.end());
+    return true;
+}
+
+bool ClassFileAnalyzer::WriteKeys(const DependencyGraph& graph)
+{
+    // Classes that were only referenced have no source or class file when
+    // they come from outside the tree; their names alone stand for them.
+    vector<Sha256::Digest> contents(graph.NodeCount());
+    vector<uint8_t> bytes;
+    for (DependencyGraph::NodeId node = 0; node < graph.NodeCount(); ++node)
+    {
+        if (!ReadContent(graph.Name(node), bytes))
+            bytes.clear();
+        contents[node] = Sha256::Of(bytes.data(), bytes.size());
+    }
+
+    CacheKeys keys(graph, contents);
+    for (DependencyGraph::NodeId node = 0; node < graph.NodeCount(); ++node)
+    {
+        if (!graph.IsAnalyzed(node))
+            continue;
+        string path = outputPath(graph.Name(node), "key");
+        FILE* outFile = fopenPath(&path[0]);
+        if (!outFile)
+        {
+            mError = "unable to open output file " + path;
+            return false;
+        }
+        fprintf(outFile, "%s\n", keys.Key(node).Hex().c_str());
+        if (fclose(outFile) != 0)
+        {
+            mError = "error writing output file " + path;
+            return false;
+        }
+    }
+    return true;
+}
+
+FILE* ClassFileAnalyzer::MergedOutput()
+{
+    return openMergedOutput() ? mOutFile : NULL;
+}
+
+bool ClassFileAnalyzer::FinishOutput()
+{
+    bool ok = true;
+    if (mGraph)
+    {
+        ok = WriteGraph(*mGraph);
+        delete mGraph;
+        mGraph = 0;
+    }
+    if (mDatabase && !mDatabase->Save() && ok)
+    {
+        mError = mDatabase->Error();
+        ok = false;
+    }
+    if (mOutFile && mOutFile != stdout)
+    {
+        if (fclose(mOutFile) != 0 && ok)
+        {
+            mError = "error writing output file " + mOutputPath;
+            ok = false;
+        }
+    }
+    else if (mOutFile)
+        fflush(mOutFile);
+    mOutFile = 0;
+    return ok;
 }
 
-void ClassFileAnalyzer::WriteDependencyFile(FILE* outFile) const
+bool ClassFileAnalyzer::WriteGraph(DependencyGraph& graph)
 {
-    const char* name = mPackageAndName.c_str();
-    fprintf(outFile, "%s%s.class: \\\n", mClassRoot.c_str(), name);
+    if (mFormat != gTabFormat && mFormat != gBinFormat)
+    {
+        mError = "a whole graph can only be written in tab or bin format";
+        return false;
+    }
+    if (!openMergedOutput())
+        return false;
+
+    graph.Canonicalize();
+    if (mFormat == gBinFormat)
+        graph.WriteBinary(mOutFile);
+    else
+        graph.WriteTabular(mOutFile);
+    return true;
+}
+
+bool ClassFileAnalyzer::WriteGraph(const ExternalGraph& graph)
+{
+    if (mFormat != gTabFormat && mFormat != gBinFormat)
+    {
+        mError = "a whole graph can only be written in tab or bin format";
+        return false;
+    }
+    if (!openMergedOutput())
+        return false;
+
+    if (mFormat == gBinFormat)
+        graph.WriteBinary(mOutFile);
+    else
+        graph.WriteTabular(mOutFile);
+    return true;
+}
+
+bool ClassFileAnalyzer::WritePackages(const PackageGraph& packages)
+{
+    if (mFormat == gBinFormat)
+    {
+        mError = "a package graph can only be written in d or tab format";
+        return false;
+    }
+    if (!openMergedOutput())
+        return false;
+
+    if (mFormat == gDepFormat)
+        packages.WriteMakefile(mOutFile);
+    else
+        packages.WriteTabular(mOutFile);
+    return true;
+}
+
+string ClassFileAnalyzer::formatDependencyFile() const
+{
+    string text = mClassFilePath + ": \\\n";
     for (StringSet::iterator it=mDeps.begin(); it!=mDeps.end(); ++it)
     {
         const char* dep = it->c_str();
         if (index(dep, '$') == NULL)
-            fprintf(outFile, "  %s%s.java \\\n", mJavaRoot.c_str(), dep);
+            text += "  " + mJavaPath.PathFor(*it) + " \\\n";
     }
-    fprintf(outFile, "\n");
+    text += "\n";
+    return text;
 }
 
-void ClassFileAnalyzer::WriteTabularOutput(FILE* outFile) const
+string ClassFileAnalyzer::formatTabularOutput() const
 {
-    const char* name = mPackageAndName.c_str();
+    string text;
     for (StringSet::iterator it=mDeps.begin(); it!=mDeps.end(); ++it)
     {
         const char* dep = it->c_str();
         if (index(dep, '$') == NULL)
-            fprintf(outFile, "%s\t%s\n", name, dep);
+            text += mPackageAndName + "\t" + *it + "\n";
     }
+    return text;
 }
 
 bool ClassFileAnalyzer::addDep(const char* name)
 {
-    int before = mDeps.size();
+    size_t before = mDeps.size();
     mDeps.insert(name);
     return before != mDeps.size();
 }
 
 
+string ClassFileAnalyzer::WithClassSuffix(const string& fullClassPath)
+{
+    // The .class suffix is optional on the command line
+    size_t len = fullClassPath.length();
+    size_t sufLen = gClassSuffix.length();
+    if (len > sufLen && fullClassPath.compare(len-sufLen, sufLen, gClassSuffix) == 0)
+        return fullClassPath;
+    return fullClassPath + gClassSuffix;
+}
+
 string ClassFileAnalyzer::FullClassPathToPackageAndName(const string& fullClassPath) const
 {
     // Initialize our result to the fullClassPath
     string packageAndName(fullClassPath);
 
-    // We must have a class file, i.e. a .class suffix
-    const string suffix(".class");
-    const size_t sufLen = suffix.length();
+    // Lop off the .class suffix, which WithClassSuffix guarantees
+    const size_t sufLen = gClassSuffix.length();
     size_t packNameLen = packageAndName.length();
-    assert(packageAndName.substr(packNameLen-sufLen) == suffix);
-
-    // Now lop off the suffix
     packageAndName.resize(packNameLen-sufLen);
 
-    // The fullClassPath must begin with the class root path
-    const size_t rootLen = mClassRoot.length();
-    assert(packageAndName.substr(0, rootLen) == mClassRoot);
-
-    // Now remove the root path
-    packageAndName = packageAndName.substr(rootLen);
+    // Now remove whichever class root the fullClassPath lies under
+    packageAndName = classPath().StripRoot(packageAndName);
 
     // packageAndName is now {packagepath}/{classname}, e.g:
     // com/redsealsys/srm/server/analysis/compactTree/CompactTreeTrafficFlow
     return packageAndName;
 }
 
-void ClassFileAnalyzer::analyzeClassFile(const string& fullClassPath)
+bool ClassFileAnalyzer::analyzeClassFile(const string& fullClassPath)
 {
     mDeps.clear();
-    mPackageAndName = FullClassPathToPackageAndName(fullClassPath);
+    mError.clear();
+    mClassBytes = 0;
+    mRoot = false;
+    mClassFilePath = WithClassSuffix(fullClassPath);
+    mPackageAndName = FullClassPathToPackageAndName(mClassFilePath);
     findDeps(mPackageAndName);
+    return mError.empty();
 }
 
 string ClassFileAnalyzer::PackageToPath(const string& name)
@@ -176,16 +610,72 @@ string ClassFileAnalyzer::PackageToPath(const string& name)
     return pathName;
 }
 
+string ClassFileAnalyzer::ClassToPath(const string& name)
+{
+    string pathName(name);
+    std::replace(pathName.begin(), pathName.end(), '.', '/');
+    return pathName;
+}
+
 void ClassFileAnalyzer::findDeps(const string& packageAndName)
 {
     const char* name = packageAndName.c_str();
-    fprintf(stderr, "Analyzing %s\n", name);
-    char infilename[1000];
-    snprintf(infilename, sizeof(infilename), "%s%s.class", mClassRoot.c_str(), name);
-    ClassFile classFile(infilename);
+    if (mTrace)
+        fprintf(mTrace, "Analyzing %s\n", name);
+    TraceSpan span(mTraceEvents, TraceBuffer::kFindDeps, packageAndName);
+    vector<uint8_t> bytes;
+    if (!classPath().ReadFile(packageAndName, bytes, mTraceEvents))
+    {
+        if (mError.empty())
+            mError = "unable to open class file " + classPath().PathFor(packageAndName);
+        return;
+    }
+    mClassBytes += bytes.size();
+    span.SetSize(bytes.size());
+
+    TraceSpan parse(mTraceEvents, TraceBuffer::kParse, packageAndName);
+    ClassFile classFile(name, bytes.data(), bytes.size());
+    parse.SetSize(bytes.size());
+    parse.End();
+    if (!classFile.Ok())
+    {
+        if (mError.empty())
+            mError = classFile.Error();
+        return;
+    }
     classFile.findDepsInFile(name, *this);
 }
 
+void ClassFileAnalyzer::visitDependency(const char* name)
+{
+    if (isIncludedClass(name) && addDep(name) && mVisitor)
+        mVisitor->visitDependency(name);
+}
+
+void ClassFileAnalyzer::visitInnerClass(const char* name)
+{
+    if (isIncludedClass(name) && addDep(name))
+    {
+        if (mVisitor)
+            mVisitor->visitInnerClass(name);
+        findDeps(name);    // Recurses here!!
+    }
+}
+
+void ClassFileAnalyzer::visitAnnotation(const char* name)
+{
+    if (isIncludedClass(name) && addDep(name) && mVisitor)
+        mVisitor->visitAnnotation(name);
+}
+
+void ClassFileAnalyzer::visitClassAnnotation(const char* name)
+{
+    if (mRootAnnotations.count(name))
+        mRoot = true;
+    if (mVisitor)
+        mVisitor->visitClassAnnotation(name);
+}
+
 bool ClassFileAnalyzer::matchPackage(const string& name, const StringSet& packages)
 {
     for (StringSet::iterator it=packages.begin(); it!=packages.end(); ++it)
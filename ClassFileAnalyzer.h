@@ -2,20 +2,179 @@
 
 #pragma once
 
+#include "ClassFileVisitor.h"
+#include "ClassPath.h"
+
+#include <stdio.h>
+
 #include <set>
 #include <string>
 
 using std::set;
 using std::string;
 
-class ClassFileAnalyzer
+class DependencyDatabase;
+class DependencyGraph;
+class ExternalGraph;
+class GraphSink;
+class PackageGraph;
+class TraceBuffer;
+class TraceLog;
+
+class ClassFileAnalyzer : public ClassFileVisitor
 {
 public:
+    struct Analysis
+    {
+        string      classFilePath;
+        string      packageAndName;
+        set<string> deps;
+        uint64_t    classBytes;     // size of the class file and its inner classes
+        bool        root;           // carries a root annotation
+        string      error;
+
+        Analysis() : classBytes(0), root(false) {}
+    };
+
     ClassFileAnalyzer();
+    ~ClassFileAnalyzer();
+
+    explicit ClassFileAnalyzer(const ClassFileAnalyzer* shared);
+    // An analyzer for another thread. It has shared's package filters and
+    // trace, and reads through shared's class path, which must be indexed
+    // and must outlive it. It only analyzes: what it finds is handed to
+    // shared, or another analyzer, with SwapAnalysis.
+
+    void IndexClassPath();
+    // Builds the class and source indexes. Call once all roots are added.
+
+    bool analyzeClassFile(const string& fullClassPath);
+    // Collects the dependencies of the class in fullClassPath and of its
+    // inner classes. Returns false, leaving the reason in Error(), if any of
+    // those class files could not be read.
+
+    void SwapAnalysis(Analysis& analysis);
+    // Exchanges what the last analyzeClassFile found, and its Error(), with
+    // analysis, so that a class one analyzer found can be written by another.
+
+    bool WriteOutput();
+    // Writes the dependencies found by the last analyzeClassFile.
+    // Returns false, leaving the reason in Error(), on failure.
+
+    string OutputPath(const string& packageAndName) const
+    {
+        if (!mDatabaseScope.empty())
+            return databasePath(packageAndName);
+        return outputPath(packageAndName, mFormat.c_str());
+    }
+    // The per-class output file of packageAndName, or with a database, the
+    // fragment holding its entry.
+
+    bool RemoveOutput(const string& packageAndName);
+    // Deletes the per-class output file, or database entry, of a class that
+    // no longer exists. Returns false, leaving the reason in Error(), on
+    // failure.
+
+    bool OutputDelta(vector<string>& removed, vector<string>& added);
+    // Compares the dependencies of the last analyzed class with those its
+    // output file lists, so call it before WriteOutput replaces the file:
+    // removed gets what the file lists that the class no longer has, added
+    // the reverse, each sorted. Both are as the output names them: classes
+    // in tab format, source files in d format. A missing file lists nothing.
+    // Returns false, leaving the reason in Error(), if it cannot be read.
+
+    bool WritesPerClassFiles() const;
+    // True unless output is merged or in bin format.
+
+    bool FinishOutput();
+    // Writes anything WriteOutput was holding back, i.e. the whole graph in
+    // bin format or the changed database fragments, and closes the merged
+    // output file.
+
+    bool WriteGraph(DependencyGraph& graph);
+    bool WriteGraph(const ExternalGraph& graph);
+    // Writes graph, canonicalized, to the merged output in tab or bin format.
+    // An ExternalGraph must have been built.
+
+    bool WritePackages(const PackageGraph& packages);
+    // Writes packages to the merged output as make rules in d format, or as
+    // weighted edges in tab format.
 
-    void analyzeClassFile(const string& fullClassPath);
+    void AddToGraph(GraphSink& graph) const;
+    // Adds the class found by the last analyzeClassFile, its dependencies as
+    // the tab format would list them, and its class file size, to graph.
 
-    void WriteOutput() const;
+    bool WriteKeys(const DependencyGraph& graph);
+    // Writes a build cache key for each analyzed class in graph to a .key
+    // file beside its .d file, the key covering the class and everything it
+    // transitively depends on. graph must hold the whole tree.
+
+    bool ReadContent(const string& packageAndName, vector<uint8_t>& bytes) const;
+    // What a class's cache key hashes as its own content: its source file if
+    // one is on the source path, otherwise its class file followed by those
+    // of its inner classes, in name order. Returns false if there is
+    // neither. Call IndexClassPath first.
+
+    FILE* MergedOutput();
+    // The file merged output goes to, opened if need be. Returns NULL,
+    // leaving the reason in Error(), if it cannot be opened.
+
+    bool SetShard(int index, int count);
+    // Restricts analysis to shard index of count. Returns false if the shard
+    // is out of range.
+
+    int ShardCount() const { return mShardCount; }
+
+    const string& PackageAndName() const { return mPackageAndName; }
+    // The class the last analyzeClassFile analyzed.
+
+    void AddRootAnnotation(const string& name)
+    {
+        mRootAnnotations.insert(ClassToPath(name));
+    }
+
+    bool IsRoot() const { return mRoot; }
+    // Whether the class the last analyzeClassFile analyzed, or one of its
+    // inner classes, is annotated with a root annotation, visible at run time
+    // or not. Only the class's own annotations count, not ones nested in
+    // their element values. Annotations are matched before the package
+    // filters, so they can be in any package.
+
+    string PackageAndNameOf(const string& fullClassPath) const;
+    // The class name analyzeClassFile would give fullClassPath.
+
+    bool HasClassFile(const string& packageAndName) const
+    {
+        return classPath().Find(packageAndName);
+    }
+
+    string SourcePathFor(const string& packageAndName) const
+    {
+        return mJavaPath.PathFor(packageAndName);
+    }
+    // The source file of a class, as d format output names it.
+
+    bool InShard(const string& fullClassPath) const;
+    // True if the class in fullClassPath belongs to our shard.
+
+    static int ShardOf(const string& packageAndName, int count);
+    // The shard a class belongs to, determined by its outer class name alone
+    // so inner classes stay with their outer class.
+
+    const string& Error() const { return mError; }
+
+    void SetTrace(FILE* trace) { mTrace = trace; }
+    // Names each class file on trace as it is analyzed. Off by default, since
+    // the analyzer never writes to stderr on its own.
+
+    void SetTraceLog(TraceLog* log);
+    // Records timed events for each file into log: this analyzer's on the
+    // calling thread, and those of the analyzers made from it on their own
+    // threads. log must outlive them all.
+
+    void SetVisitor(ClassFileVisitor* visitor) { mVisitor = visitor; }
+    // Streams each new dependency, inner class and annotation that passes the
+    // package filters to visitor as analysis proceeds.
 
     void includePackage(const string& name)
     {
@@ -35,35 +194,65 @@ public:
 
     void findDeps(const string& packageAndName);
 
-    void SetJavaRoot(const string& root)
+    bool AddJavaRoots(const string& roots)
     {
-        mJavaRoot = SavePath(root);
+        return addRoots(mJavaPath, roots);
     }
-    void SetClassRoot(const string& root)
+    bool AddClassRoots(const string& roots)
     {
-        mClassRoot = SavePath(root);
+        return addRoots(mClassPath, roots);
     }
     void SetDepRoot(const string& root)
     {
         mDepRoot = SavePath(root);
     }
 
-    void SetFormat(const string& format);
+    bool SetFormat(const string& format);
+    // Returns false if format is not one we know how to write.
 
     void MergeOutput() { mMergeOutput = true; }
 
+    bool SetDatabase(const string& scope);
+    // Gathers per-class output into one fragment per package, for a scope
+    // of "package", or one for the whole tree, for "tree", each entry
+    // replaced as its class is written again. Returns false for any other
+    // scope. Only for d or tab output to per-class files.
+
+    void SetOutputFile(const string& path)
+    {
+        mOutputPath = path;
+        mMergeOutput = true;
+    }
+
+    // ClassFileVisitor
+    virtual void visitDependency(const char* name);
+    virtual void visitInnerClass(const char* name);
+    virtual void visitAnnotation(const char* name);
+    virtual void visitClassAnnotation(const char* name);
+
 private:
+    bool addRoots(ClassPath& path, const string& roots);
+    const ClassPath& classPath() const { return mShared ? mShared->mClassPath : mClassPath; }
+    bool openMergedOutput();
+    string outputPath(const string& packageAndName, const char* suffix) const;
+    string databasePath(const string& packageAndName) const;
+    DependencyDatabase& database();
+
+    void outputEntries(set<string>& entries) const;
+    bool readOutputEntries(const string& path, set<string>& entries);
 
-    void WriteDependencyFile(FILE* outFile) const;
-    void WriteTabularOutput(FILE* outFile) const;
+    string formatDependencyFile() const;
+    string formatTabularOutput() const;
 
     string FullClassPathToPackageAndName(const string& fullClassPath) const;
+    static string WithClassSuffix(const string& fullClassPath);
 
 
 private:
     typedef set<string> StringSet;
 
     static string PackageToPath(const string& name);
+    static string ClassToPath(const string& name);
 
     static bool matchPackage(const string& name, const StringSet& packages);
 
@@ -79,15 +268,35 @@ private:
 private:
     StringSet mExcludedPackages;
     StringSet mIncludedPackages;
+    StringSet mRootAnnotations;
 
-    string mJavaRoot;
-    string mClassRoot;
-    string mDepRoot;
+    ClassPath mJavaPath;
+    ClassPath mClassPath;
+    const ClassFileAnalyzer* mShared;
+    string    mDepRoot;
 
     string mFormat;
     bool   mMergeOutput;
+    string mOutputPath;
+
+    FILE*               mOutFile;
+    DependencyGraph*    mGraph;
+    string              mDatabaseScope;
+    DependencyDatabase* mDatabase;
+
+    int mShardIndex;
+    int mShardCount;
+
+    FILE*             mTrace;
+    TraceLog*         mTraceLog;
+    TraceBuffer*      mTraceEvents;     // this analyzer's thread's
+    ClassFileVisitor* mVisitor;
+    string            mError;
 
+    string    mClassFilePath;
     string    mPackageAndName;
     StringSet mDeps;
+    uint64_t  mClassBytes;      // size of the class file and its inner classes
+    bool      mRoot;            // carries a root annotation
 };
 
@@ -0,0 +1,30 @@
+// ClassFileVisitor.h
+
+#pragma once
+
+// Receives the dependency events ClassFile::findDepsInFile finds in a single
+// class file. Names are package paths such as com/fudco/jdepexample/Foo and
+// are only valid for the duration of the call.
+class ClassFileVisitor
+{
+public:
+    virtual ~ClassFileVisitor() {}
+
+    virtual void visitDependency(const char* name) = 0;
+    // Called for each class the file refers to. References to another class's
+    // inner class are reported as a dependency on its outer class.
+
+    virtual void visitInnerClass(const char* name) = 0;
+    // Called for each of the file's own inner classes. The caller is expected
+    // to find the inner class's file and visit it too, since the outer class
+    // depends on whatever its inner classes depend on.
+
+    virtual void visitAnnotation(const char* name) = 0;
+    // Called for each annotation type and annotation enum type found in the
+    // class's RuntimeVisibleAnnotations.
+
+    virtual void visitClassAnnotation(const char*) {}
+    // Called for the type of each annotation applied to the class itself,
+    // visible at run time or not, but not for annotations or enum types
+    // nested in their element values.
+};
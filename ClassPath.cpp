@@ -0,0 +1,219 @@
+// ClassPath.cpp
+
+#include "ClassPath.h"
+#include "JarFile.h"
+#include "TraceLog.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+ClassPath::ClassPath(const string& suffix)
+    : mSuffix(suffix)
+    , mIndexed(false)
+{
+}
+
+ClassPath::~ClassPath()
+{
+    for (size_t i = 0; i < mRoots.size(); ++i)
+        delete mRoots[i].jar;
+}
+
+bool ClassPath::isArchive(const string& path)
+{
+    size_t len = path.size();
+    return len > 4 && (path.compare(len-4, 4, ".jar") == 0 || path.compare(len-4, 4, ".zip") == 0);
+}
+
+bool ClassPath::AddRoots(const string& spec)
+{
+    size_t start = 0;
+    while (start <= spec.size())
+    {
+        size_t end = spec.find(':', start);
+        if (end == string::npos)
+            end = spec.size();
+        string path(spec, start, end - start);
+        start = end + 1;
+        if (path.empty())
+            continue;
+
+        Root root;
+        root.jar = 0;
+        if (isArchive(path))
+        {
+            root.path = path;
+            root.jar = new JarFile(path);
+            if (!root.jar->Ok())
+            {
+                mError = root.jar->Error();
+                delete root.jar;
+                return false;
+            }
+        }
+        else
+        {
+            root.path = path;
+            if (path[path.size()-1] != '/')
+                root.path += '/';
+        }
+        mRoots.push_back(root);
+    }
+    return true;
+}
+
+void ClassPath::BuildIndex()
+{
+    if (mRoots.size() < 2 && (mRoots.empty() || !mRoots[0].jar))
+        return;
+
+    for (uint32_t i = 0; i < mRoots.size(); ++i)
+    {
+        if (mRoots[i].jar)
+            indexJar(i);
+        else
+            indexDirectory(i, "");
+    }
+    mIndexed = true;
+}
+
+void ClassPath::addToIndex(const string& fileName, uint32_t root, uint32_t entry)
+{
+    size_t len = fileName.size();
+    size_t sufLen = mSuffix.size();
+    if (len <= sufLen || fileName.compare(len-sufLen, sufLen, mSuffix) != 0)
+        return;
+
+    Location location;
+    location.root = root;
+    location.entry = entry;
+    // emplace leaves an existing entry alone, so earlier roots win
+    mIndex.emplace(fileName.substr(0, len-sufLen), location);
+}
+
+void ClassPath::indexDirectory(uint32_t root, const string& relative)
+{
+    string dirPath = mRoots[root].path + relative;
+    DIR* dir = opendir(dirPath.c_str());
+    if (!dir)
+        return;
+
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL)
+    {
+        const char* name = ent->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+            continue;
+
+        string child = relative + name;
+        bool isDir = ent->d_type == DT_DIR;
+        if (ent->d_type == DT_UNKNOWN || ent->d_type == DT_LNK)
+        {
+            struct stat st;
+            isDir = stat((dirPath + name).c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+        }
+        if (isDir)
+            indexDirectory(root, child + '/');
+        else
+            addToIndex(child, root, 0);
+    }
+    closedir(dir);
+}
+
+void ClassPath::indexJar(uint32_t root)
+{
+    const JarFile* jar = mRoots[root].jar;
+    for (size_t i = 0; i < jar->EntryCount(); ++i)
+        addToIndex(jar->EntryName(i), root, i);
+}
+
+const ClassPath::Location* ClassPath::lookup(const string& packageAndName) const
+{
+    Index::const_iterator it = mIndex.find(packageAndName);
+    if (it == mIndex.end())
+        return NULL;
+    return &it->second;
+}
+
+bool ClassPath::Find(const string& packageAndName) const
+{
+    if (indexed())
+        return lookup(packageAndName) != NULL;
+
+    struct stat st;
+    return stat(PathFor(packageAndName).c_str(), &st) == 0;
+}
+
+string ClassPath::PathFor(const string& packageAndName) const
+{
+    if (indexed())
+    {
+        const Location* location = lookup(packageAndName);
+        if (location)
+        {
+            const Root& root = mRoots[location->root];
+            if (root.jar)
+                return root.path;
+            return root.path + packageAndName + mSuffix;
+        }
+    }
+
+    if (mRoots.empty() || mRoots[0].jar)
+        return packageAndName + mSuffix;
+    return mRoots[0].path + packageAndName + mSuffix;
+}
+
+bool ClassPath::ReadFile(const string& packageAndName, vector<uint8_t>& bytes,
+                         TraceBuffer* trace) const
+{
+    TraceSpan open(trace, TraceBuffer::kOpen, packageAndName);
+    if (indexed())
+    {
+        const Location* location = lookup(packageAndName);
+        if (!location)
+            return false;
+        const Root& root = mRoots[location->root];
+        if (root.jar)
+        {
+            open.End();
+            TraceSpan read(trace, TraceBuffer::kRead, packageAndName);
+            bool ok = root.jar->Extract(location->entry, bytes);
+            read.SetSize(bytes.size());
+            return ok;
+        }
+    }
+
+    string path = PathFor(packageAndName);
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    open.End();
+
+    TraceSpan read(trace, TraceBuffer::kRead, packageAndName);
+    struct stat st;
+    bool ok = fstat(fileno(file), &st) == 0;
+    if (ok)
+    {
+        bytes.resize(st.st_size);
+        ok = fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        read.SetSize(bytes.size());
+    }
+    fclose(file);
+    return ok;
+}
+
+string ClassPath::StripRoot(const string& path) const
+{
+    size_t best = 0;
+    for (size_t i = 0; i < mRoots.size(); ++i)
+    {
+        const Root& root = mRoots[i];
+        size_t len = root.path.size();
+        if (!root.jar && len > best && path.compare(0, len, root.path) == 0)
+            best = len;
+    }
+    return path.substr(best);
+}
@@ -0,0 +1,81 @@
+// ClassPath.h
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+class JarFile;
+class TraceBuffer;
+
+class ClassPath
+{
+public:
+    ClassPath(const string& suffix);
+    ~ClassPath();
+
+    bool AddRoots(const string& spec);
+    // Adds each colon-separated entry of spec as a root, in order.
+    // Entries ending in .jar or .zip are archives; anything else is a
+    // directory. Earlier roots shadow later ones, as with a Java classpath.
+    // Returns false, leaving the reason in Error(), if an archive is unreadable.
+
+    const string& Error() const { return mError; }
+
+    void BuildIndex();
+    // Builds the hashed index from class name to root. A single directory
+    // root needs no index, since every lookup is a path concatenation.
+
+    bool Find(const string& packageAndName) const;
+    // Returns true if some root holds packageAndName.
+
+    string PathFor(const string& packageAndName) const;
+    // Returns the path of the file that holds packageAndName: the loose file
+    // in whichever root has it, or the archive it lives in. Names that are
+    // not found anywhere map into the first root.
+
+    bool ReadFile(const string& packageAndName, vector<uint8_t>& bytes,
+                  TraceBuffer* trace = 0) const;
+    // Reads the contents of packageAndName from whichever root holds it,
+    // recording the open and the read into trace if given.
+
+    string StripRoot(const string& path) const;
+    // Returns path with the longest matching directory root removed.
+
+private:
+    struct Root
+    {
+        string   path;      // directory with trailing '/', or archive
+        JarFile* jar;       // NULL for a directory
+    };
+
+    struct Location
+    {
+        uint32_t root;
+        uint32_t entry;     // index into the archive, unused for directories
+    };
+
+    typedef unordered_map<string, Location> Index;
+
+    bool indexed() const { return mIndexed; }
+    const Location* lookup(const string& packageAndName) const;
+    void indexDirectory(uint32_t root, const string& relative);
+    void indexJar(uint32_t root);
+    void addToIndex(const string& fileName, uint32_t root, uint32_t entry);
+
+    static bool isArchive(const string& path);
+
+private:
+    string       mSuffix;
+    vector<Root> mRoots;
+    Index        mIndex;
+    bool         mIndexed;
+    string       mError;
+};
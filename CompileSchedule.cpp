@@ -0,0 +1,154 @@
+// CompileSchedule.cpp
+
+#include "CompileSchedule.h"
+
+#include <algorithm>
+
+CompileSchedule::CompileSchedule(const DependencyGraph& graph, const vector<string>& stale,
+                                 int workers)
+    : mCriticalCost(0)
+{
+    // The stale classes, with just the dependencies among them: anything
+    // else is already compiled, and javac reads its class file.
+    vector<string> names(stale);
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    DependencyGraph subgraph;
+    for (size_t i = 0; i < names.size(); ++i)
+        subgraph.AddNode(names[i]);
+
+    vector<NodeId> deps;
+    for (NodeId node = 0; node < subgraph.NodeCount(); ++node)
+    {
+        NodeId old;
+        if (!graph.Find(names[node], old))
+            continue;
+        deps.clear();
+        const vector<NodeId>& edges = graph.Deps(old);
+        for (size_t i = 0; i < edges.size(); ++i)
+        {
+            NodeId dep;
+            if (subgraph.Find(graph.Name(edges[i]), dep))
+                deps.push_back(dep);
+        }
+        subgraph.SetClass(node, deps, graph.Size(old));
+    }
+
+    vector<Component> components;
+    levelize(subgraph, components);
+    pack(components, workers < 1 ? 1 : workers);
+}
+
+void CompileSchedule::levelize(const DependencyGraph& stale, vector<Component>& components) const
+{
+    vector<uint32_t> component;
+    size_t count = stale.StronglyConnectedComponents(component);
+    vector<vector<NodeId> > members(count);
+    components.assign(count, Component());
+    for (NodeId node = 0; node < stale.NodeCount(); ++node)
+    {
+        Component& c = components[component[node]];
+        members[component[node]].push_back(node);
+        c.classes.push_back(stale.Name(node));
+        // A class new since the graph was built has no size yet
+        c.cost += std::max<uint64_t>(stale.Size(node), 1);
+    }
+
+    // Components are numbered dependencies first, so each one's dependencies
+    // are placed before it is
+    for (uint32_t c = 0; c < count; ++c)
+    {
+        Component& current = components[c];
+        current.level = 0;
+        current.pathCost = current.cost;
+        current.pathNext = -1;
+        for (size_t m = 0; m < members[c].size(); ++m)
+        {
+            const vector<NodeId>& deps = stale.Deps(members[c][m]);
+            for (size_t i = 0; i < deps.size(); ++i)
+            {
+                uint32_t d = component[deps[i]];
+                if (d == c)
+                    continue;
+                current.level = std::max(current.level, components[d].level + 1);
+                if (components[d].pathCost + current.cost > current.pathCost)
+                {
+                    current.pathCost = components[d].pathCost + current.cost;
+                    current.pathNext = d;
+                }
+            }
+        }
+    }
+}
+
+static bool costlierFirst(const std::pair<uint64_t, uint32_t>& a,
+                          const std::pair<uint64_t, uint32_t>& b)
+{
+    // Ties go by component number, so the plan is the same every time
+    if (a.first != b.first)
+        return a.first > b.first;
+    return a.second < b.second;
+}
+
+void CompileSchedule::pack(vector<Component>& components, int workers)
+{
+    int32_t critical = -1;
+    uint32_t levels = 0;
+    for (uint32_t c = 0; c < components.size(); ++c)
+    {
+        levels = std::max(levels, components[c].level + 1);
+        if (critical < 0 || components[c].pathCost > components[critical].pathCost)
+            critical = c;
+    }
+
+    // Each level is packed on its own, the costliest component going to the
+    // least loaded batch
+    vector<vector<uint32_t> > byLevel(levels);
+    for (uint32_t c = 0; c < components.size(); ++c)
+        byLevel[components[c].level].push_back(c);
+    for (uint32_t level = 0; level < levels; ++level)
+    {
+        vector<std::pair<uint64_t, uint32_t> > order;
+        for (size_t i = 0; i < byLevel[level].size(); ++i)
+            order.push_back(std::make_pair(components[byLevel[level][i]].cost, byLevel[level][i]));
+        std::sort(order.begin(), order.end(), costlierFirst);
+
+        size_t first = mBatches.size();
+        size_t count = std::min<size_t>(workers, order.size());
+        for (size_t w = 0; w < count; ++w)
+        {
+            Batch batch;
+            batch.level = level;
+            batch.worker = w;
+            batch.cost = 0;
+            mBatches.push_back(batch);
+        }
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            size_t target = first;
+            for (size_t b = first + 1; b < mBatches.size(); ++b)
+            {
+                if (mBatches[b].cost < mBatches[target].cost)
+                    target = b;
+            }
+            Component& component = components[order[i].second];
+            mBatches[target].cost += component.cost;
+            mBatches[target].classes.insert(mBatches[target].classes.end(),
+                                            component.classes.begin(), component.classes.end());
+        }
+        for (size_t b = first; b < mBatches.size(); ++b)
+            std::sort(mBatches[b].classes.begin(), mBatches[b].classes.end());
+    }
+
+    if (critical < 0)
+        return;
+    mCriticalCost = components[critical].pathCost;
+    vector<int32_t> chain;
+    for (int32_t c = critical; c >= 0; c = components[c].pathNext)
+        chain.push_back(c);
+    for (size_t i = chain.size(); i-- > 0; )
+    {
+        const vector<string>& classes = components[chain[i]].classes;
+        mCriticalPath.insert(mCriticalPath.end(), classes.begin(), classes.end());
+    }
+}
@@ -0,0 +1,67 @@
+// CompileSchedule.h
+
+#pragma once
+
+#include "DependencyGraph.h"
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// Plans how to recompile a set of stale classes as parallel javac batches.
+// Classes that depend on each other through a cycle must be compiled
+// together, so the stale classes are grouped into the strongly connected
+// components of the dependencies among them, and the components levelized:
+// each goes one level above the highest of those it depends on. The
+// components of a level are independent, and are packed into at most N
+// batches of about equal cost; the levels run one after another. Cost is
+// class file size, as a proxy for compile time.
+class CompileSchedule
+{
+public:
+    CompileSchedule(const DependencyGraph& graph, const vector<string>& stale, int workers);
+    // graph holds the dependencies as the last build left them; classes in
+    // stale that it does not know depend on nothing.
+
+    struct Batch
+    {
+        uint32_t       level;
+        uint32_t       worker;
+        uint64_t       cost;
+        vector<string> classes;
+    };
+
+    const vector<Batch>& Batches() const { return mBatches; }
+    // In level order; a level's batches can run at once.
+
+    uint64_t CriticalCost() const { return mCriticalCost; }
+
+    const vector<string>& CriticalPath() const { return mCriticalPath; }
+    // The classes of the costliest chain of components, dependencies first.
+    // Its cost bounds how fast any schedule can finish, however many workers
+    // run it.
+
+private:
+    typedef DependencyGraph::NodeId NodeId;
+
+    struct Component
+    {
+        uint32_t       level;
+        uint64_t       cost;
+        uint64_t       pathCost;    // cost of the costliest chain ending here
+        int32_t        pathNext;    // the component before it on that chain
+        vector<string> classes;
+    };
+
+    void levelize(const DependencyGraph& stale, vector<Component>& components) const;
+    void pack(vector<Component>& components, int workers);
+
+private:
+    vector<Batch>  mBatches;
+    uint64_t       mCriticalCost;
+    vector<string> mCriticalPath;
+};
@@ -0,0 +1,145 @@
+// DependencyDatabase.cpp
+
+#include "DependencyDatabase.h"
+#include "FilePath.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+DependencyDatabase::DependencyDatabase(bool tabular)
+    : mTabular(tabular)
+{
+}
+
+DependencyDatabase::Fragment* DependencyDatabase::load(const string& path)
+{
+    map<string, Fragment>::iterator it = mFragments.find(path);
+    if (it != mFragments.end())
+        return &it->second;
+
+    Fragment fragment;
+    FILE* inFile = fopen(path.c_str(), "rb");
+    if (inFile)
+    {
+        char buffer[65536];
+        size_t got;
+        while ((got = fread(buffer, 1, sizeof(buffer), inFile)) > 0)
+            fragment.content.append(buffer, got);
+        bool ok = !ferror(inFile);
+        fclose(inFile);
+        if (!ok)
+        {
+            mError = "error reading dependency file " + path;
+            return 0;
+        }
+    }
+    else if (errno != ENOENT)
+    {
+        mError = "unable to open dependency file " + path;
+        return 0;
+    }
+    parse(fragment.content, fragment.entries);
+
+    Fragment& added = mFragments[path];
+    added.entries.swap(fragment.entries);
+    added.content.swap(fragment.content);
+    return &added;
+}
+
+void DependencyDatabase::parse(const string& content, Entries& entries) const
+{
+    string* entry = 0;
+    size_t start = 0;
+    while (start < content.size())
+    {
+        size_t end = content.find('\n', start);
+        end = end == string::npos ? content.size() : end + 1;
+        string line = content.substr(start, end - start);
+        start = end;
+
+        if (mTabular)
+        {
+            entry = &entries[line.substr(0, line.find('\t'))];
+            *entry += line;
+        }
+        else if (line.compare(0, 2, "# ") == 0)
+        {
+            size_t length = line.size() - 2 - (line[line.size() - 1] == '\n');
+            entry = &entries[line.substr(2, length)];
+        }
+        else if (entry)
+            *entry += line;
+    }
+}
+
+string DependencyDatabase::render(const Entries& entries) const
+{
+    string content;
+    for (Entries::const_iterator it = entries.begin(); it != entries.end(); ++it)
+    {
+        if (!mTabular)
+            content += "# " + it->first + "\n";
+        content += it->second;
+    }
+    return content;
+}
+
+bool DependencyDatabase::SetEntry(const string& fragment, const string& packageAndName,
+                                  const string& text)
+{
+    Fragment* loaded = load(fragment);
+    if (!loaded)
+        return false;
+    loaded->entries[packageAndName] = text;
+    return true;
+}
+
+bool DependencyDatabase::RemoveEntry(const string& fragment, const string& packageAndName)
+{
+    Fragment* loaded = load(fragment);
+    if (!loaded)
+        return false;
+    loaded->entries.erase(packageAndName);
+    return true;
+}
+
+bool DependencyDatabase::Save()
+{
+    for (map<string, Fragment>::iterator it = mFragments.begin(); it != mFragments.end(); ++it)
+    {
+        const string& path = it->first;
+        string content = render(it->second.entries);
+        if (content == it->second.content)
+            continue;
+
+        // Leave make nothing to read for a package with no classes left
+        if (content.empty())
+        {
+            if (unlink(path.c_str()) != 0 && errno != ENOENT)
+            {
+                mError = "unable to remove dependency file " + path;
+                return false;
+            }
+            it->second.content.clear();
+            continue;
+        }
+
+        string temporary = path + ".tmp";
+        FILE* outFile = fopenPath(&temporary[0]);
+        if (!outFile)
+        {
+            mError = "unable to open dependency file " + temporary;
+            return false;
+        }
+        bool ok = fwrite(content.data(), 1, content.size(), outFile) == content.size();
+        if (fclose(outFile) != 0 || !ok || rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            remove(temporary.c_str());
+            mError = "error writing dependency file " + path;
+            return false;
+        }
+        it->second.content.swap(content);
+    }
+    return true;
+}
@@ -0,0 +1,53 @@
+// DependencyDatabase.h
+
+#pragma once
+
+#include <map>
+#include <string>
+
+using std::map;
+using std::string;
+
+// Per-class outputs gathered into a few fragment files, so that make reads
+// one file per package, or per tree, rather than one per class. Each
+// fragment holds one entry per class, in class order, and an entry is
+// replaced whenever its class is written again. Fragments are read the
+// first time one of their classes is touched and, by Save, rewritten
+// whole, and only if their content changed.
+class DependencyDatabase
+{
+public:
+    explicit DependencyDatabase(bool tabular);
+    // Entries in tab format are keyed by the class that starts each line;
+    // others are marked by a "# class" comment line before them.
+
+    bool SetEntry(const string& fragment, const string& packageAndName, const string& text);
+    bool RemoveEntry(const string& fragment, const string& packageAndName);
+    // Both return false, leaving the reason in Error(), if fragment exists
+    // but cannot be read.
+
+    bool Save();
+    // Replaces each fragment that changed with its new content, by renaming
+    // a complete copy over it, and deletes those left empty. Returns false,
+    // leaving the reason in Error(), on failure.
+
+    const string& Error() const { return mError; }
+
+private:
+    typedef map<string, string> Entries;    // class -> its output
+
+    struct Fragment
+    {
+        Entries entries;
+        string  content;    // as read, to tell whether it changed
+    };
+
+    Fragment* load(const string& path);
+    void parse(const string& content, Entries& entries) const;
+    string render(const Entries& entries) const;
+
+private:
+    bool                      mTabular;
+    map<string, Fragment>     mFragments;
+    string                    mError;
+};
@@ -0,0 +1,436 @@
+// DependencyGraph.cpp
+
+#include "DependencyGraph.h"
+#include "GraphFormat.h"
+
+#include <algorithm>
+#include <string.h>
+
+DependencyGraph::DependencyGraph()
+{
+}
+
+DependencyGraph::NodeId DependencyGraph::AddNode(const string& name)
+{
+    NodeId node;
+    if (mNames.empty() && (mSorted.Size() == 0 || mSorted.Last() < name))
+    {
+        // After every name so far, so both new and in order
+        node = NodeCount();
+        mSorted.Append(name);
+    }
+    else
+    {
+        if (Find(name, node))
+            return node;
+        node = NodeCount();
+        mNames.push_back(name);
+        mIndex[name] = node;
+    }
+    mDeps.push_back(vector<NodeId>());
+    mAnalyzed.push_back(false);
+    mSizes.push_back(0);
+    return node;
+}
+
+void DependencyGraph::AddEdge(NodeId from, NodeId to)
+{
+    mAnalyzed[from] = true;
+    mDeps[from].push_back(to);
+}
+
+void DependencyGraph::AddClass(const string& name, const set<string>& deps, uint64_t size)
+{
+    NodeId from = AddNode(name);
+    mAnalyzed[from] = true;
+    mSizes[from] = size;
+    for (set<string>::const_iterator it = deps.begin(); it != deps.end(); ++it)
+        AddEdge(from, AddNode(*it));
+}
+
+void DependencyGraph::SetClass(NodeId node, const vector<NodeId>& deps, uint64_t size)
+{
+    mAnalyzed[node] = true;
+    mSizes[node] = size;
+    mDeps[node] = deps;
+}
+
+void DependencyGraph::RemoveClass(NodeId node)
+{
+    mAnalyzed[node] = false;
+    mSizes[node] = 0;
+    vector<NodeId>().swap(mDeps[node]);
+}
+
+string DependencyGraph::Name(NodeId node) const
+{
+    if (node < mSorted.Size())
+        return mSorted.Get(node);
+    return mNames[node - mSorted.Size()];
+}
+
+bool DependencyGraph::Find(const string& name, NodeId& node) const
+{
+    size_t index;
+    if (mSorted.Find(name, index))
+    {
+        node = index;
+        return true;
+    }
+    NodeIndex::const_iterator it = mIndex.find(name);
+    if (it == mIndex.end())
+        return false;
+    node = it->second;
+    return true;
+}
+
+void DependencyGraph::Merge(const DependencyGraph& other)
+{
+    vector<NodeId> remap(other.NodeCount());
+    for (NodeId node = 0; node < other.NodeCount(); ++node)
+        remap[node] = AddNode(other.Name(node));
+
+    for (NodeId node = 0; node < other.NodeCount(); ++node)
+    {
+        if (other.mAnalyzed[node])
+            mAnalyzed[remap[node]] = true;
+        mSizes[remap[node]] = std::max(mSizes[remap[node]], other.mSizes[node]);
+        const vector<NodeId>& deps = other.mDeps[node];
+        for (size_t i = 0; i < deps.size(); ++i)
+            mDeps[remap[node]].push_back(remap[deps[i]]);
+    }
+}
+
+struct NameOrder
+{
+    const vector<string>& names;
+
+    NameOrder(const vector<string>& _names) : names(_names) {}
+
+    bool operator()(DependencyGraph::NodeId a, DependencyGraph::NodeId b) const
+    {
+        return names[a] < names[b];
+    }
+};
+
+void DependencyGraph::nameOrder(vector<NodeId>& order, NameStore* names) const
+{
+    // The stored names are in order already; sort the others and merge them in
+    size_t stored = mSorted.Size();
+    vector<NodeId> tail(mNames.size());
+    for (NodeId i = 0; i < tail.size(); ++i)
+        tail[i] = i;
+    std::sort(tail.begin(), tail.end(), NameOrder(mNames));
+
+    order.clear();
+    order.reserve(NodeCount());
+    NameStore::Cursor cursor(mSorted);
+    string name;
+    bool more = cursor.Next(name);
+    NodeId next = 0;
+    size_t t = 0;
+    while (more || t < tail.size())
+    {
+        if (more && (t == tail.size() || name < mNames[tail[t]]))
+        {
+            if (names)
+                names->Append(name);
+            order.push_back(next++);
+            more = cursor.Next(name);
+        }
+        else
+        {
+            if (names)
+                names->Append(mNames[tail[t]]);
+            order.push_back(stored + tail[t++]);
+        }
+    }
+}
+
+void DependencyGraph::NameRanks(vector<uint32_t>& rank) const
+{
+    size_t count = NodeCount();
+    rank.resize(count);
+    if (mNames.empty())
+    {
+        for (NodeId node = 0; node < count; ++node)
+            rank[node] = node;
+        return;
+    }
+    vector<NodeId> order;
+    nameOrder(order, 0);
+    for (NodeId node = 0; node < count; ++node)
+        rank[order[node]] = node;
+}
+
+void DependencyGraph::Canonicalize(vector<NodeId>* oldToNew)
+{
+    size_t count = NodeCount();
+    NameStore names;
+    vector<NodeId> order;
+    nameOrder(order, &names);
+
+    vector<NodeId> local;
+    vector<NodeId>& remap = oldToNew ? *oldToNew : local;
+    remap.resize(count);
+    for (NodeId node = 0; node < count; ++node)
+        remap[order[node]] = node;
+
+    vector<vector<NodeId> > deps(count);
+    vector<bool> analyzed(count);
+    vector<uint64_t> sizes(count);
+    for (NodeId old = 0; old < count; ++old)
+    {
+        NodeId node = remap[old];
+        analyzed[node] = mAnalyzed[old];
+        sizes[node] = mSizes[old];
+        vector<NodeId>& edges = deps[node];
+        edges.swap(mDeps[old]);
+        for (size_t i = 0; i < edges.size(); ++i)
+            edges[i] = remap[edges[i]];
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    }
+    mSorted.Swap(names);
+    vector<string>().swap(mNames);
+    NodeIndex().swap(mIndex);
+    mDeps.swap(deps);
+    mAnalyzed.swap(analyzed);
+    mSizes.swap(sizes);
+}
+
+size_t DependencyGraph::StronglyConnectedComponents(vector<uint32_t>& component) const
+{
+    // Tarjan's algorithm, with an explicit stack so that long dependency
+    // chains cannot overflow the call stack.
+    const uint32_t kUnvisited = UINT32_MAX;
+    size_t count = NodeCount();
+    vector<uint32_t> index(count, kUnvisited);
+    vector<uint32_t> lowLink(count);
+    vector<bool> onStack(count, false);
+    vector<NodeId> stack;
+    vector<std::pair<NodeId, size_t> > frames;   // node, next edge to follow
+    uint32_t nextIndex = 0;
+    uint32_t components = 0;
+
+    component.assign(count, 0);
+    for (NodeId root = 0; root < count; ++root)
+    {
+        if (index[root] != kUnvisited)
+            continue;
+        frames.push_back(std::make_pair(root, 0));
+        index[root] = lowLink[root] = nextIndex++;
+        stack.push_back(root);
+        onStack[root] = true;
+
+        while (!frames.empty())
+        {
+            NodeId node = frames.back().first;
+            size_t& edge = frames.back().second;
+            const vector<NodeId>& deps = mDeps[node];
+            if (edge < deps.size())
+            {
+                NodeId next = deps[edge++];
+                if (index[next] == kUnvisited)
+                {
+                    index[next] = lowLink[next] = nextIndex++;
+                    stack.push_back(next);
+                    onStack[next] = true;
+                    frames.push_back(std::make_pair(next, 0));
+                }
+                else if (onStack[next])
+                    lowLink[node] = std::min(lowLink[node], index[next]);
+                continue;
+            }
+
+            if (lowLink[node] == index[node])
+            {
+                NodeId member;
+                do
+                {
+                    member = stack.back();
+                    stack.pop_back();
+                    onStack[member] = false;
+                    component[member] = components;
+                } while (member != node);
+                ++components;
+            }
+            frames.pop_back();
+            if (!frames.empty())
+            {
+                NodeId parent = frames.back().first;
+                lowLink[parent] = std::min(lowLink[parent], lowLink[node]);
+            }
+        }
+    }
+    return components;
+}
+
+void DependencyGraph::Reachable(const vector<NodeId>& roots, vector<bool>& reached) const
+{
+    reached.assign(NodeCount(), false);
+    vector<NodeId> stack;
+    for (size_t i = 0; i < roots.size(); ++i)
+    {
+        if (!reached[roots[i]])
+        {
+            reached[roots[i]] = true;
+            stack.push_back(roots[i]);
+        }
+    }
+    while (!stack.empty())
+    {
+        NodeId node = stack.back();
+        stack.pop_back();
+        const vector<NodeId>& deps = mDeps[node];
+        for (size_t i = 0; i < deps.size(); ++i)
+        {
+            if (!reached[deps[i]])
+            {
+                reached[deps[i]] = true;
+                stack.push_back(deps[i]);
+            }
+        }
+    }
+}
+
+bool DependencyGraph::Read(const string& path)
+{
+    FILE* inFile = fopen(path.c_str(), "rb");
+    if (!inFile)
+    {
+        mError = "unable to open graph file " + path;
+        return false;
+    }
+
+    bool ok = isBinaryGraph(inFile) ? ReadBinary(inFile) : ReadTabular(inFile);
+    fclose(inFile);
+    if (!ok)
+    {
+        mError += " in " + path;
+        return false;
+    }
+    // Fold the names the file added into the store
+    Canonicalize();
+    return true;
+}
+
+bool DependencyGraph::ReadTabular(FILE* inFile)
+{
+    char line[10000];
+    while (fgets(line, sizeof(line), inFile))
+    {
+        size_t len = strlen(line);
+        if (len > 0 && line[len-1] == '\n')
+            line[--len] = '\0';
+        if (len == 0)
+            continue;
+
+        char* tab = strchr(line, '\t');
+        if (!tab)
+        {
+            mError = string("malformed line \"") + line + "\"";
+            return false;
+        }
+        *tab = '\0';
+        AddEdge(AddNode(line), AddNode(tab + 1));
+    }
+    return true;
+}
+
+bool DependencyGraph::ReadBinary(FILE* inFile)
+{
+    mError = "truncated or corrupt binary graph";
+
+    char magic[kGraphMagicLength];
+    if (fread(magic, 1, kGraphMagicLength, inFile) != kGraphMagicLength
+        || memcmp(magic, kGraphMagic, kGraphMagicLength) != 0)
+        return false;
+
+    uint64_t count;
+    if (!readVarint(inFile, count))
+        return false;
+
+    // Ids in the file are relative to the file; map them onto ours, which
+    // differ when reading into a graph that already has nodes.
+    vector<NodeId> remap;
+    string name;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        uint64_t flags, size;
+        if (!readGraphName(inFile, name)
+            || !readVarint(inFile, flags) || !readVarint(inFile, size))
+            return false;
+        NodeId node = AddNode(name);
+        if (flags & kAnalyzedFlag)
+            mAnalyzed[node] = true;
+        mSizes[node] = std::max(mSizes[node], size);
+        remap.push_back(node);
+    }
+
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        uint64_t edges;
+        if (!readVarint(inFile, edges))
+            return false;
+        uint64_t target = 0;
+        for (uint64_t e = 0; e < edges; ++e)
+        {
+            uint64_t gap;
+            if (!readVarint(inFile, gap))
+                return false;
+            target += gap;
+            if (target >= count)
+                return false;
+            mDeps[remap[i]].push_back(remap[target]);
+        }
+    }
+
+    mError.clear();
+    return true;
+}
+
+void DependencyGraph::WriteTabular(FILE* outFile) const
+{
+    for (NodeId node = 0; node < NodeCount(); ++node)
+    {
+        const vector<NodeId>& deps = mDeps[node];
+        if (deps.empty())
+            continue;
+        string name = Name(node);
+        for (size_t i = 0; i < deps.size(); ++i)
+            fprintf(outFile, "%s\t%s\n", name.c_str(), Name(deps[i]).c_str());
+    }
+}
+
+void DependencyGraph::WriteBinary(FILE* outFile) const
+{
+    fwrite(kGraphMagic, 1, kGraphMagicLength, outFile);
+    writeVarint(outFile, NodeCount());
+    NameStore::Cursor cursor(mSorted);
+    string name, previous;
+    for (NodeId node = 0; node < NodeCount(); ++node)
+    {
+        if (!cursor.Next(name))
+            name = mNames[node - mSorted.Size()];
+        writeGraphName(outFile, node, previous, name.data(), name.size());
+        previous = name;
+        writeVarint(outFile, mAnalyzed[node] ? kAnalyzedFlag : 0);
+        writeVarint(outFile, mSizes[node]);
+    }
+
+    vector<NodeId> deps;
+    for (NodeId node = 0; node < NodeCount(); ++node)
+    {
+        deps = mDeps[node];
+        std::sort(deps.begin(), deps.end());
+        deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+        writeVarint(outFile, deps.size());
+        NodeId previous = 0;
+        for (size_t i = 0; i < deps.size(); ++i)
+        {
+            writeVarint(outFile, deps[i] - previous);
+            previous = deps[i];
+        }
+    }
+}
@@ -0,0 +1,112 @@
+// DependencyGraph.h
+
+#pragma once
+
+#include "GraphSink.h"
+#include "NameStore.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using std::set;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+// A whole-tree class dependency graph: one node per class name, with an edge
+// from each analyzed class to each class its source file depends on, exactly
+// as the tab format lists them. Names added in sorted order, as graph files
+// and Canonicalize leave them, are kept front-coded in a NameStore; only
+// those added out of order are held as strings until the next Canonicalize.
+class DependencyGraph : public GraphSink
+{
+public:
+    typedef uint32_t NodeId;
+
+    DependencyGraph();
+
+    NodeId AddNode(const string& name);
+    // Returns the node for name, adding it if it is new.
+
+    void AddClass(const string& name, const set<string>& deps, uint64_t size = 0);
+
+    void AddEdge(NodeId from, NodeId to);
+
+    void SetClass(NodeId node, const vector<NodeId>& deps, uint64_t size);
+    // Marks node analyzed, replacing its edges and size.
+
+    void RemoveClass(NodeId node);
+    // Drops node's edges and marks it unanalyzed. The node stays, since
+    // other classes may still name it.
+
+    size_t NodeCount() const { return mSorted.Size() + mNames.size(); }
+
+    string Name(NodeId node) const;
+    // Decodes the name, which costs up to a block of NameStore names: sort
+    // by NameRanks rather than by Name.
+
+    void NameRanks(vector<uint32_t>& rank) const;
+    // Each node's position in name order, so that sorting nodes by name
+    // compares numbers rather than decoding names.
+
+    bool Find(const string& name, NodeId& node) const;
+
+    bool IsAnalyzed(NodeId node) const { return mAnalyzed[node]; }
+
+    uint64_t Size(NodeId node) const { return mSizes[node]; }
+    // Zero if unknown, as for classes that were only referenced.
+
+    const vector<NodeId>& Deps(NodeId node) const { return mDeps[node]; }
+    // Sorted by node id once Canonicalize has been called.
+
+    void Merge(const DependencyGraph& other);
+    // Adds all of other's nodes and edges to this graph.
+
+    size_t StronglyConnectedComponents(vector<uint32_t>& component) const;
+    // Labels each node with its strongly connected component and returns the
+    // number of components. Components are numbered in reverse topological
+    // order: every edge goes from a component to one numbered no higher.
+
+    void Reachable(const vector<NodeId>& roots, vector<bool>& reached) const;
+    // Marks each node that some root reaches, the roots included, following
+    // each edge at most once.
+
+    void Canonicalize(vector<NodeId>* oldToNew = 0);
+    // Renumbers the nodes in name order and sorts every edge list, so that
+    // graphs with the same content compare and serialize identically
+    // however they were built. oldToNew, if given, receives each old node's
+    // new id.
+
+    bool Read(const string& path);
+    // Reads a graph in either format, telling them apart by the binary magic,
+    // and canonicalizes the result. Returns false, leaving the reason in
+    // Error(), on failure.
+
+    bool ReadTabular(FILE* inFile);
+    bool ReadBinary(FILE* inFile);
+
+    void WriteTabular(FILE* outFile) const;
+    void WriteBinary(FILE* outFile) const;
+    // Both write in node order; Canonicalize first for deterministic output.
+
+    const string& Error() const { return mError; }
+
+private:
+    typedef unordered_map<string, NodeId> NodeIndex;
+
+    void nameOrder(vector<NodeId>& order, NameStore* names) const;
+    // The nodes in name order, and with names, their names appended to it.
+
+    NameStore              mSorted;     // names of the first nodes, in order
+    vector<string>         mNames;      // names of the nodes after them
+    vector<vector<NodeId> > mDeps;
+    vector<bool>           mAnalyzed;
+    vector<uint64_t>       mSizes;
+    NodeIndex              mIndex;      // of mNames
+    string                 mError;
+};
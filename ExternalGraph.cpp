@@ -0,0 +1,504 @@
+// ExternalGraph.cpp
+
+#include "ExternalGraph.h"
+#include "GraphFormat.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+bool ExternalGraph::NameTable::Create(const string& dir)
+{
+    mEnd = 0;
+    mCount = 0;
+    if (mData.Create(dir) && mOffsets.Create(dir))
+        return true;
+    mError = mData.Error().empty() ? mOffsets.Error() : mData.Error();
+    return false;
+}
+
+bool ExternalGraph::NameTable::Append(const string& name)
+{
+    if (fwrite(&mEnd, sizeof(mEnd), 1, mOffsets.Stream()) != 1
+        || fwrite(name.data(), 1, name.size(), mData.Stream()) != name.size())
+    {
+        mError = "error writing name table spill file";
+        return false;
+    }
+    mEnd += name.size();
+    ++mCount;
+    return true;
+}
+
+bool ExternalGraph::NameTable::Finish()
+{
+    if (fwrite(&mEnd, sizeof(mEnd), 1, mOffsets.Stream()) != 1
+        || fflush(mData.Stream()) != 0 || fflush(mOffsets.Stream()) != 0)
+    {
+        mError = "error writing name table spill file";
+        return false;
+    }
+    // Mapping zero bytes fails, so an empty table maps one
+    if (mData.Map(std::max(mEnd, (uint64_t) 1)) && mOffsets.Map((mCount + 1) * sizeof(uint64_t)))
+        return true;
+    mError = mData.Error().empty() ? mOffsets.Error() : mData.Error();
+    return false;
+}
+
+const char* ExternalGraph::NameTable::Name(NodeId node) const
+{
+    const uint64_t* offsets = (const uint64_t*) mOffsets.Data();
+    return (const char*) mData.Data() + offsets[node];
+}
+
+size_t ExternalGraph::NameTable::Length(NodeId node) const
+{
+    const uint64_t* offsets = (const uint64_t*) mOffsets.Data();
+    return offsets[node+1] - offsets[node];
+}
+
+bool ExternalGraph::NameTable::Find(const string& name, NodeId& node) const
+{
+    // Binary search, comparing bytewise as std::string does
+    size_t low = 0, high = mCount;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        size_t length = Length(middle);
+        int order = memcmp(Name(middle), name.data(), std::min(length, name.size()));
+        if (order == 0)
+            order = length < name.size() ? -1 : length > name.size() ? 1 : 0;
+        if (order == 0)
+        {
+            node = middle;
+            return true;
+        }
+        if (order < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return false;
+}
+
+ExternalGraph::ExternalGraph(const string& spillDir, size_t memoryBudget)
+    : mSpillDir(spillDir)
+    , mBudget(memoryBudget)
+    , mEdges(spillDir, memoryBudget - memoryBudget / 8)
+    , mSizes(spillDir, memoryBudget / 8)
+    , mNodeCount(0)
+    , mEdgeCount(0)
+    , mComponentCount(0)
+{
+}
+
+bool ExternalGraph::fail(const string& error)
+{
+    mError = error;
+    return false;
+}
+
+static string sizeRecord(const string& name, uint64_t size)
+{
+    char digits[32];
+    snprintf(digits, sizeof(digits), "\t%" PRIu64, size);
+    return name + digits;
+}
+
+void ExternalGraph::AddClass(const string& name, const set<string>& deps, uint64_t size)
+{
+    if (!mError.empty())
+        return;
+    if (!mSizes.Add(sizeRecord(name, size)))
+    {
+        mError = mSizes.Error();
+        return;
+    }
+    for (set<string>::const_iterator it = deps.begin(); it != deps.end(); ++it)
+    {
+        if (!mEdges.Add(name + '\t' + *it))
+        {
+            mError = mEdges.Error();
+            return;
+        }
+    }
+}
+
+bool ExternalGraph::Read(const string& path)
+{
+    FILE* inFile = fopen(path.c_str(), "rb");
+    if (!inFile)
+        return fail("unable to open graph file " + path);
+
+    bool ok = isBinaryGraph(inFile) ? readBinary(inFile) : readTabular(inFile);
+    fclose(inFile);
+    if (!ok)
+        mError += " in " + path;
+    return ok;
+}
+
+bool ExternalGraph::readTabular(FILE* inFile)
+{
+    char* line = 0;
+    size_t capacity = 0;
+    ssize_t length;
+    bool ok = true;
+    while (ok && (length = getline(&line, &capacity, inFile)) >= 0)
+    {
+        if (length > 0 && line[length-1] == '\n')
+            line[--length] = '\0';
+        if (length == 0)
+            continue;
+        if (!strchr(line, '\t'))
+            ok = fail(string("malformed line \"") + line + "\"");
+        else if (!mEdges.Add(line))
+            ok = fail(mEdges.Error());
+    }
+    free(line);
+    return ok;
+}
+
+bool ExternalGraph::readBinary(FILE* inFile)
+{
+    const char* corrupt = "truncated or corrupt binary graph";
+
+    char magic[kGraphMagicLength];
+    uint64_t count;
+    if (fread(magic, 1, kGraphMagicLength, inFile) != kGraphMagicLength
+        || memcmp(magic, kGraphMagic, kGraphMagicLength) != 0 || !readVarint(inFile, count))
+        return fail(corrupt);
+
+    // The edges name nodes by their id in the file, so keep the file's names
+    // in a table of their own to translate them.
+    NameTable names;
+    if (!names.Create(mSpillDir))
+        return fail(names.Error());
+    string name;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        uint64_t flags, size;
+        if (!readGraphName(inFile, name)
+            || !readVarint(inFile, flags) || !readVarint(inFile, size))
+            return fail(corrupt);
+        if (!names.Append(name))
+            return fail(names.Error());
+        if ((flags & kAnalyzedFlag) && !mSizes.Add(sizeRecord(name, size)))
+            return fail(mSizes.Error());
+    }
+    if (!names.Finish())
+        return fail(names.Error());
+
+    string record;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        uint64_t edges;
+        if (!readVarint(inFile, edges))
+            return fail(corrupt);
+        uint64_t target = 0;
+        for (uint64_t e = 0; e < edges; ++e)
+        {
+            uint64_t gap;
+            if (!readVarint(inFile, gap))
+                return fail(corrupt);
+            target += gap;
+            if (target >= count)
+                return fail(corrupt);
+            record.assign(names.Name(i), names.Length(i));
+            record += '\t';
+            record.append(names.Name(target), names.Length(target));
+            if (!mEdges.Add(record))
+                return fail(mEdges.Error());
+        }
+    }
+    return true;
+}
+
+bool ExternalGraph::Build()
+{
+    if (!mError.empty())
+        return false;
+
+    // Whatever the collecting sorters still hold stays in memory while the
+    // name sorter runs, so it gets the rest of the budget.
+    size_t held = mEdges.MemoryUsed() + mSizes.MemoryUsed();
+    size_t budget = std::max(mBudget > held ? mBudget - held : 0, mBudget / 4);
+
+    return buildNames(budget) && buildEdges() && buildDependents() && findComponents();
+}
+
+bool ExternalGraph::buildNames(size_t budget)
+{
+    // Every class named anywhere becomes a node, numbered in name order
+    ExternalSorter names(mSpillDir, budget);
+    string record, last;
+    mEdgeCount = 0;
+    if (!mEdges.Sort())
+        return fail(mEdges.Error());
+    while (mEdges.Next(record))
+    {
+        size_t tab = record.find('\t');
+        if (record.compare(0, tab, last) != 0)
+        {
+            last.assign(record, 0, tab);
+            if (!names.Add(last))
+                return fail(names.Error());
+        }
+        if (!names.Add(record.substr(tab + 1)))
+            return fail(names.Error());
+        ++mEdgeCount;
+    }
+    if (!mEdges.Error().empty())
+        return fail(mEdges.Error());
+
+    if (!mSizes.Sort())
+        return fail(mSizes.Error());
+    while (mSizes.Next(record))
+    {
+        if (!names.Add(record.substr(0, record.find('\t'))))
+            return fail(names.Error());
+    }
+    if (!mSizes.Error().empty())
+        return fail(mSizes.Error());
+
+    if (!names.Sort() || !mNames.Create(mSpillDir))
+        return fail(names.Error().empty() ? mNames.Error() : names.Error());
+    string name;
+    while (names.Next(name))
+    {
+        if (!mNames.Append(name))
+            return fail(mNames.Error());
+    }
+    if (!names.Error().empty())
+        return fail(names.Error());
+    if (!mNames.Finish())
+        return fail(mNames.Error());
+
+    mNodeCount = mNames.Count();
+    if (mNodeCount >= UINT32_MAX)
+        return fail("too many classes for one graph");
+    return true;
+}
+
+bool ExternalGraph::buildEdges()
+{
+    if (!mAnalyzed.Allocate(mSpillDir, mNodeCount)
+        || !mNodeSizes.Allocate(mSpillDir, mNodeCount)
+        || !mDepOffsets.Allocate(mSpillDir, mNodeCount + 1)
+        || !mDepTargets.Allocate(mSpillDir, mEdgeCount))
+        return fail("unable to allocate graph in " + mSpillDir);
+
+    string record;
+    NodeId node;
+    if (!mSizes.Sort())
+        return fail(mSizes.Error());
+    while (mSizes.Next(record))
+    {
+        size_t tab = record.find('\t');
+        if (!mNames.Find(record.substr(0, tab), node))
+            return fail("class missing from name table");
+        uint64_t size = strtoull(record.c_str() + tab + 1, 0, 10);
+        mAnalyzed[node] = 1;
+        mNodeSizes[node] = std::max(mNodeSizes[node], size);
+    }
+    if (!mSizes.Error().empty())
+        return fail(mSizes.Error());
+
+    // The records come sorted by class then dependency, which is node order
+    // twice over, so the adjacency arrays fill in from front to back.
+    string last;
+    NodeId from = 0;
+    NodeId next = 0;     // first node whose offset is still to be set
+    uint64_t edge = 0;
+    if (!mEdges.Sort())
+        return fail(mEdges.Error());
+    while (mEdges.Next(record))
+    {
+        size_t tab = record.find('\t');
+        if (edge == 0 || record.compare(0, tab, last) != 0)
+        {
+            last.assign(record, 0, tab);
+            if (!mNames.Find(last, from))
+                return fail("class missing from name table");
+            mAnalyzed[from] = 1;
+            while (next <= from)
+                mDepOffsets[next++] = edge;
+        }
+        NodeId to;
+        if (!mNames.Find(record.substr(tab + 1), to) || edge >= mEdgeCount)
+            return fail("class missing from name table");
+        mDepTargets[edge++] = to;
+    }
+    if (!mEdges.Error().empty())
+        return fail(mEdges.Error());
+    while (next <= mNodeCount)
+        mDepOffsets[next++] = edge;
+    return true;
+}
+
+bool ExternalGraph::buildDependents()
+{
+    // Count each node's dependents into the slot after its own, sum the
+    // counts into offsets, then place each edge at its target's cursor.
+    MappedArray<uint64_t> cursor;
+    if (!mDependentOffsets.Allocate(mSpillDir, mNodeCount + 1)
+        || !mDependentSources.Allocate(mSpillDir, mEdgeCount)
+        || !cursor.Allocate(mSpillDir, mNodeCount))
+        return fail("unable to allocate graph in " + mSpillDir);
+
+    for (uint64_t edge = 0; edge < mEdgeCount; ++edge)
+        ++mDependentOffsets[mDepTargets[edge] + 1];
+    for (size_t node = 0; node < mNodeCount; ++node)
+    {
+        mDependentOffsets[node + 1] += mDependentOffsets[node];
+        cursor[node] = mDependentOffsets[node];
+    }
+    for (NodeId node = 0; node < mNodeCount; ++node)
+    {
+        for (uint64_t edge = mDepOffsets[node]; edge < mDepOffsets[node + 1]; ++edge)
+            mDependentSources[cursor[mDepTargets[edge]]++] = node;
+    }
+    return true;
+}
+
+bool ExternalGraph::findComponents()
+{
+    // DependencyGraph::StronglyConnectedComponents over the mapped arrays,
+    // with its working arrays and stacks mapped too. Indexes are stored plus
+    // one so that the zeros a new spill file reads as mean unvisited.
+    MappedArray<uint32_t> index, lowLink, stack, frameNode;
+    MappedArray<uint8_t> onStack;
+    MappedArray<uint64_t> frameEdge;
+    if (!mComponent.Allocate(mSpillDir, mNodeCount)
+        || !index.Allocate(mSpillDir, mNodeCount)
+        || !lowLink.Allocate(mSpillDir, mNodeCount)
+        || !stack.Allocate(mSpillDir, mNodeCount)
+        || !frameNode.Allocate(mSpillDir, mNodeCount)
+        || !onStack.Allocate(mSpillDir, mNodeCount)
+        || !frameEdge.Allocate(mSpillDir, mNodeCount))
+        return fail("unable to allocate graph in " + mSpillDir);
+
+    size_t stackSize = 0, frames = 0;
+    uint32_t nextIndex = 1;
+    uint32_t components = 0;
+    for (NodeId root = 0; root < mNodeCount; ++root)
+    {
+        if (index[root])
+            continue;
+        frameNode[frames] = root;
+        frameEdge[frames++] = mDepOffsets[root];
+        index[root] = lowLink[root] = nextIndex++;
+        stack[stackSize++] = root;
+        onStack[root] = 1;
+
+        while (frames)
+        {
+            NodeId node = frameNode[frames - 1];
+            uint64_t& edge = frameEdge[frames - 1];
+            if (edge < mDepOffsets[node + 1])
+            {
+                NodeId next = mDepTargets[edge++];
+                if (!index[next])
+                {
+                    index[next] = lowLink[next] = nextIndex++;
+                    stack[stackSize++] = next;
+                    onStack[next] = 1;
+                    frameNode[frames] = next;
+                    frameEdge[frames++] = mDepOffsets[next];
+                }
+                else if (onStack[next])
+                    lowLink[node] = std::min(lowLink[node], index[next]);
+                continue;
+            }
+
+            if (lowLink[node] == index[node])
+            {
+                NodeId member;
+                do
+                {
+                    member = stack[--stackSize];
+                    onStack[member] = 0;
+                    mComponent[member] = components;
+                } while (member != node);
+                ++components;
+            }
+            if (--frames)
+            {
+                NodeId parent = frameNode[frames - 1];
+                lowLink[parent] = std::min(lowLink[parent], lowLink[node]);
+            }
+        }
+    }
+    mComponentCount = components;
+    return true;
+}
+
+void ExternalGraph::writeName(FILE* outFile, NodeId node) const
+{
+    fwrite(mNames.Name(node), 1, mNames.Length(node), outFile);
+}
+
+void ExternalGraph::WriteTabular(FILE* outFile) const
+{
+    for (NodeId node = 0; node < mNodeCount; ++node)
+    {
+        for (uint64_t edge = mDepOffsets[node]; edge < mDepOffsets[node + 1]; ++edge)
+        {
+            writeName(outFile, node);
+            putc('\t', outFile);
+            writeName(outFile, mDepTargets[edge]);
+            putc('\n', outFile);
+        }
+    }
+}
+
+void ExternalGraph::WriteBinary(FILE* outFile) const
+{
+    fwrite(kGraphMagic, 1, kGraphMagicLength, outFile);
+    writeVarint(outFile, mNodeCount);
+    string previous;
+    for (NodeId node = 0; node < mNodeCount; ++node)
+    {
+        writeGraphName(outFile, node, previous, mNames.Name(node), mNames.Length(node));
+        previous.assign(mNames.Name(node), mNames.Length(node));
+        writeVarint(outFile, mAnalyzed[node] ? kAnalyzedFlag : 0);
+        writeVarint(outFile, mNodeSizes[node]);
+    }
+    for (NodeId node = 0; node < mNodeCount; ++node)
+    {
+        writeVarint(outFile, mDepOffsets[node + 1] - mDepOffsets[node]);
+        NodeId previous = 0;
+        for (uint64_t edge = mDepOffsets[node]; edge < mDepOffsets[node + 1]; ++edge)
+        {
+            writeVarint(outFile, mDepTargets[edge] - previous);
+            previous = mDepTargets[edge];
+        }
+    }
+}
+
+void ExternalGraph::WriteComponents(FILE* outFile) const
+{
+    for (NodeId node = 0; node < mNodeCount; ++node)
+    {
+        writeName(outFile, node);
+        fprintf(outFile, "\t%u\n", mComponent[node]);
+    }
+}
+
+void ExternalGraph::WriteDependents(FILE* outFile) const
+{
+    for (NodeId node = 0; node < mNodeCount; ++node)
+    {
+        for (uint64_t edge = mDependentOffsets[node]; edge < mDependentOffsets[node + 1]; ++edge)
+        {
+            NodeId dependent = mDependentSources[edge];
+            if (dependent == node)
+                continue;
+            writeName(outFile, node);
+            putc('\t', outFile);
+            writeName(outFile, dependent);
+            putc('\n', outFile);
+        }
+    }
+}
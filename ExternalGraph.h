@@ -0,0 +1,113 @@
+// ExternalGraph.h
+
+#pragma once
+
+#include "ExternalSorter.h"
+#include "GraphSink.h"
+#include "SpillFile.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+// A whole-tree dependency graph for trees too big for DependencyGraph to hold
+// in memory. Edges are collected as sorted runs spilled to disk and merged
+// when the graph is built; the built graph is a name table and forward and
+// reverse adjacency arrays in mapped spill files, which the kernel pages in
+// and out as needed. Only the sort buffers live on the heap, so the heap stays
+// within the budget however large the tree; the mapped arrays are paged in
+// at random while the components are found, and are not counted against it.
+class ExternalGraph : public GraphSink
+{
+public:
+    typedef uint32_t NodeId;
+
+    ExternalGraph(const string& spillDir, size_t memoryBudget);
+
+    void AddClass(const string& name, const set<string>& deps, uint64_t size = 0);
+    // A failure to spill is reported by Build.
+
+    bool Read(const string& path);
+    // Adds the content of a graph file in either format, streaming it.
+    // Returns false, leaving the reason in Error(), on failure.
+
+    bool Build();
+    // Call once everything is added, before anything is written. Numbers the
+    // nodes in name order, as DependencyGraph::Canonicalize does, and finds
+    // the strongly connected components. Returns false, leaving the reason in
+    // Error(), on failure.
+
+    size_t NodeCount() const { return mNodeCount; }
+    size_t EdgeCount() const { return mEdgeCount; }
+    size_t ComponentCount() const { return mComponentCount; }
+
+    void WriteTabular(FILE* outFile) const;
+    void WriteBinary(FILE* outFile) const;
+    // Byte for byte what a canonicalized DependencyGraph would write.
+
+    void WriteComponents(FILE* outFile) const;
+    // One "class<TAB>component" line per class. Components are numbered as
+    // DependencyGraph::StronglyConnectedComponents numbers them, so building
+    // them in increasing order builds every dependency first.
+
+    void WriteDependents(FILE* outFile) const;
+    // The reverse index: one "class<TAB>dependent" line for each class that
+    // depends on another, grouped by the class depended on.
+
+    const string& Error() const { return mError; }
+
+private:
+    // Names back to back in one spill file, and where each one starts in another
+    class NameTable
+    {
+    public:
+        NameTable() : mCount(0) {}
+
+        bool Create(const string& dir);
+        bool Append(const string& name);
+        bool Finish();
+        // Maps the table for lookups once every name is appended in order.
+
+        size_t Count() const { return mCount; }
+        const char* Name(NodeId node) const;
+        size_t Length(NodeId node) const;
+        bool Find(const string& name, NodeId& node) const;
+        // Names must have been appended in sorted order.
+
+        const string& Error() const { return mError; }
+
+    private:
+        SpillFile mData;
+        SpillFile mOffsets;
+        uint64_t  mEnd;     // bytes of mData written so far
+        size_t    mCount;
+        string    mError;
+    };
+
+    bool readTabular(FILE* inFile);
+    bool readBinary(FILE* inFile);
+    bool buildNames(size_t budget);
+    bool buildEdges();
+    bool buildDependents();
+    bool findComponents();
+    void writeName(FILE* outFile, NodeId node) const;
+    bool fail(const string& error);
+
+private:
+    string         mSpillDir;
+    size_t         mBudget;
+    ExternalSorter mEdges;          // "class<TAB>dep" records, the tab format
+    ExternalSorter mSizes;          // "class<TAB>size" records, one per analyzed class
+    size_t         mNodeCount;
+    size_t         mEdgeCount;
+    size_t         mComponentCount;
+    string         mError;
+
+    NameTable             mNames;
+    MappedArray<uint8_t>  mAnalyzed;
+    MappedArray<uint64_t> mNodeSizes;
+    MappedArray<uint64_t> mDepOffsets;        // node -> first of its mDepTargets
+    MappedArray<NodeId>   mDepTargets;
+    MappedArray<uint64_t> mDependentOffsets;  // node -> first of its mDependentSources
+    MappedArray<NodeId>   mDependentSources;
+    MappedArray<uint32_t> mComponent;
+};
@@ -0,0 +1,257 @@
+// ExternalSorter.cpp
+
+#include "ExternalSorter.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+
+// Memory each run being merged needs for its stdio buffer and current record
+const size_t kRunBuffer = 64 << 10;
+
+// Most runs merged at once. Spilled runs are merged in tiers of this many, so
+// a run is rewritten once per tier and few files are open at any time.
+const size_t kMaxFanIn = 16;
+
+// What each held record costs beyond its characters: the string itself, and
+// the slack the vector holding it keeps for growth.
+const size_t kRecordOverhead = 2 * sizeof(string);
+
+struct ExternalSorter::Run
+{
+    SpillFile file;
+    int       level;     // how many merges went into it
+    char*     line;      // getline's buffer
+    size_t    capacity;
+    string    current;   // the record at the head of the run
+
+    Run() : level(0), line(0), capacity(0) {}
+    ~Run() { free(line); }
+};
+
+struct RunOrder
+{
+    // Orders a heap so the run with the smallest current record is on top
+    template <typename R>
+    bool operator()(const R* a, const R* b) const { return b->current < a->current; }
+};
+
+ExternalSorter::ExternalSorter(const string& spillDir, size_t memoryBudget)
+    : mSpillDir(spillDir)
+    , mBudget(memoryBudget)
+    , mBytes(0)
+    , mPosition(0)
+    , mStarted(false)
+{
+}
+
+ExternalSorter::~ExternalSorter()
+{
+    for (size_t i = 0; i < mRuns.size(); ++i)
+        delete mRuns[i];
+}
+
+bool ExternalSorter::Add(const string& record)
+{
+    mRecords.push_back(record);
+    mBytes += record.size() + kRecordOverhead;
+    if (mBytes < mBudget)
+        return true;
+    return spill();
+}
+
+static bool writeRecord(FILE* outFile, const string& record)
+{
+    return fwrite(record.data(), 1, record.size(), outFile) == record.size()
+        && putc('\n', outFile) != EOF;
+}
+
+bool ExternalSorter::spill()
+{
+    std::sort(mRecords.begin(), mRecords.end());
+    mRecords.erase(std::unique(mRecords.begin(), mRecords.end()), mRecords.end());
+
+    Run* run = new Run;
+    mRuns.push_back(run);
+    if (!run->file.Create(mSpillDir))
+    {
+        mError = run->file.Error();
+        return false;
+    }
+    FILE* outFile = run->file.Stream();
+    bool ok = true;
+    for (size_t i = 0; ok && i < mRecords.size(); ++i)
+        ok = writeRecord(outFile, mRecords[i]);
+    if (!ok || fflush(outFile) != 0)
+    {
+        mError = "error writing spill file in " + mSpillDir;
+        return false;
+    }
+    vector<string>().swap(mRecords);
+    mBytes = 0;
+
+    // Merge a full tier into one run of the next level up
+    size_t fanIn = std::max((size_t) 2, std::min(kMaxFanIn, mBudget / kRunBuffer));
+    while (mRuns.size() >= fanIn)
+    {
+        size_t first = mRuns.size() - fanIn;
+        int level = mRuns.back()->level;
+        if (mRuns[first]->level != level)
+            break;
+        Run* merged = new Run;
+        merged->level = level + 1;
+        if (!merge(mRuns, first, fanIn, merged))
+            return false;
+    }
+    return true;
+}
+
+bool ExternalSorter::readRecord(Run* run)
+{
+    ssize_t length = getline(&run->line, &run->capacity, run->file.Stream());
+    if (length < 0)
+    {
+        if (ferror(run->file.Stream()))
+            mError = "error reading spill file in " + mSpillDir;
+        return false;
+    }
+    if (length > 0 && run->line[length-1] == '\n')
+        --length;
+    run->current.assign(run->line, length);
+    return true;
+}
+
+bool ExternalSorter::merge(vector<Run*>& runs, size_t first, size_t count, Run* output)
+{
+    // Replaces runs[first, first+count) with output, holding their records
+    vector<Run*> inputs(runs.begin() + first, runs.begin() + first + count);
+    runs.erase(runs.begin() + first, runs.begin() + first + count);
+    runs.insert(runs.begin() + first, output);
+
+    bool ok = output->file.Create(mSpillDir);
+    if (!ok)
+        mError = output->file.Error();
+
+    vector<Run*> heap;
+    for (size_t i = 0; ok && i < inputs.size(); ++i)
+    {
+        rewind(inputs[i]->file.Stream());
+        if (readRecord(inputs[i]))
+            heap.push_back(inputs[i]);
+        else
+            ok = mError.empty();
+    }
+    std::make_heap(heap.begin(), heap.end(), RunOrder());
+
+    FILE* outFile = output->file.Stream();
+    string last;
+    bool started = false;
+    while (ok && !heap.empty())
+    {
+        std::pop_heap(heap.begin(), heap.end(), RunOrder());
+        Run* run = heap.back();
+        if (!started || run->current != last)
+        {
+            if (!writeRecord(outFile, run->current))
+            {
+                mError = "error writing spill file in " + mSpillDir;
+                ok = false;
+                break;
+            }
+            last = run->current;
+            started = true;
+        }
+        if (readRecord(run))
+            std::push_heap(heap.begin(), heap.end(), RunOrder());
+        else
+        {
+            heap.pop_back();
+            ok = mError.empty();
+        }
+    }
+    if (ok && fflush(outFile) != 0)
+    {
+        mError = "error writing spill file in " + mSpillDir;
+        ok = false;
+    }
+
+    for (size_t i = 0; i < inputs.size(); ++i)
+        delete inputs[i];
+    return ok;
+}
+
+bool ExternalSorter::Sort()
+{
+    if (mRuns.empty())
+    {
+        // Everything fit in memory, so there is nothing to merge
+        std::sort(mRecords.begin(), mRecords.end());
+        mRecords.erase(std::unique(mRecords.begin(), mRecords.end()), mRecords.end());
+        mPosition = 0;
+        return true;
+    }
+
+    if (!mRecords.empty() && !spill())
+        return false;
+
+    size_t fanIn = std::max((size_t) 2, std::min(kMaxFanIn, mBudget / kRunBuffer));
+    while (mRuns.size() > fanIn)
+    {
+        Run* merged = new Run;
+        merged->level = mRuns[0]->level + 1;
+        if (!merge(mRuns, 0, fanIn, merged))
+            return false;
+    }
+
+    mHeap.clear();
+    for (size_t i = 0; i < mRuns.size(); ++i)
+    {
+        rewind(mRuns[i]->file.Stream());
+        if (readRecord(mRuns[i]))
+            mHeap.push_back(mRuns[i]);
+        else if (!mError.empty())
+            return false;
+    }
+    std::make_heap(mHeap.begin(), mHeap.end(), RunOrder());
+    mStarted = false;
+    return true;
+}
+
+bool ExternalSorter::Next(string& record)
+{
+    if (mRuns.empty())
+    {
+        if (mPosition >= mRecords.size())
+            return false;
+        record = mRecords[mPosition++];
+        return true;
+    }
+    return nextMerged(record);
+}
+
+bool ExternalSorter::nextMerged(string& record)
+{
+    while (!mHeap.empty())
+    {
+        std::pop_heap(mHeap.begin(), mHeap.end(), RunOrder());
+        Run* run = mHeap.back();
+        bool fresh = !mStarted || run->current != mLast;
+        if (fresh)
+        {
+            record = run->current;
+            mLast = record;
+            mStarted = true;
+        }
+        if (readRecord(run))
+            std::push_heap(mHeap.begin(), mHeap.end(), RunOrder());
+        else
+        {
+            mHeap.pop_back();
+            if (!mError.empty())
+                return false;
+        }
+        if (fresh)
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,60 @@
+// ExternalSorter.h
+
+#pragma once
+
+#include "SpillFile.h"
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// Sorts and dedupes more text records than fit in memory. Records are held
+// until they reach the memory budget, then sorted and spilled to disk as a
+// run; reading back merges the runs. Records are compared bytewise, as
+// std::string does, and must not contain newlines.
+class ExternalSorter
+{
+public:
+    ExternalSorter(const string& spillDir, size_t memoryBudget);
+    ~ExternalSorter();
+
+    bool Add(const string& record);
+    // Returns false, leaving the reason in Error(), if a spill fails.
+
+    bool Sort();
+    // Call once every record is added, before Next, and again to read the
+    // records over. Returns false, leaving the reason in Error(), on failure.
+
+    bool Next(string& record);
+    // The next record in order, duplicates skipped. False at the end, or on a
+    // read error, which leaves Error() set.
+
+    size_t RunCount() const { return mRuns.size(); }
+
+    size_t MemoryUsed() const { return mBytes; }
+    // What the records held in memory account for against the budget.
+
+    const string& Error() const { return mError; }
+
+private:
+    struct Run;
+
+    bool spill();
+    bool merge(vector<Run*>& runs, size_t first, size_t count, Run* output);
+    bool readRecord(Run* run);
+    bool nextMerged(string& record);
+
+private:
+    string         mSpillDir;
+    size_t         mBudget;
+    vector<string> mRecords;   // held in memory, not yet spilled
+    size_t         mBytes;     // memory mRecords accounts for
+    size_t         mPosition;  // next of mRecords to return, when nothing spilled
+    vector<Run*>   mRuns;      // sorted runs on disk
+    vector<Run*>   mHeap;      // runs being merged, smallest record first
+    string         mLast;      // last record returned, to skip duplicates
+    bool           mStarted;   // whether mLast is set
+    string         mError;
+};
@@ -0,0 +1,50 @@
+// FilePath.cpp
+
+#include "FilePath.h"
+
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+FILE* fopenPath(char* path)
+{
+    char* end = rindex(path, '/');
+    if (end)
+    {
+        *end = '\0';
+        mkdirPath(path);
+        *end = '/';
+    }
+    return fopen(path, "w");
+}
+
+bool mkdirPath(char* path)
+{
+    char* slashptr = path;
+    DIR* dyr;
+
+    while ((slashptr = strchr(slashptr + 1, '/')))
+    {
+        *slashptr = '\0';
+        dyr = opendir(path);
+        if (dyr)
+            closedir(dyr);
+        else if (mkdir(path, S_IRWXU) < 0)
+        {
+            *slashptr = '/';
+            return true;
+        }
+        *slashptr = '/';
+        if (slashptr[1] == '\0')
+        {
+            /* Just ignore a trailing slash */
+            return false;
+        }
+    }
+    if (mkdir(path, S_IRWXU) < 0)
+        return true;
+    else
+        return false;
+}
+
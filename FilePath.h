@@ -0,0 +1,13 @@
+// FilePath.h
+
+#pragma once
+
+#include <stdio.h>
+
+FILE* fopenPath(char* path);
+// Opens path for writing, first making any of its directories that do not
+// exist. path is modified while it works, but left as it was.
+
+bool mkdirPath(char* path);
+// Makes the directory path and any of its parents that do not exist.
+// Returns true on failure.
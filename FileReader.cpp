@@ -3,6 +3,7 @@
 #include "FileReader.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 bool testEndianism()
 {
@@ -32,25 +33,60 @@ void reverseBytes(char* data, int length)
 static bool gLittleEndian = testEndianism();
 
 FileReader::FileReader(const char* path)
-    : mFile(fopen(path, "rb"))
+    : mOwned(0)
+    , mCursor(0)
+    , mLimit(0)
+    , mPath(path)
 {
-    if (!mFile)
+    FILE* file = fopen(path, "rb");
+    if (!file)
     {
-        fprintf(stderr, "unable to open class file %s\n", path);
-        exit(1);
+        mError = "unable to open class file " + mPath;
+        return;
     }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    mOwned = (uint8_t*) malloc(length > 0 ? length : 1);
+    size_t got = fread(mOwned, 1, length, file);
+    fclose(file);
+
+    mCursor = mOwned;
+    mLimit = mOwned + got;
+}
+
+FileReader::FileReader(const uint8_t* bytes, size_t length, const char* name)
+    : mOwned(0)
+    , mCursor(bytes)
+    , mLimit(bytes + length)
+    , mPath(name)
+{
 }
 
 FileReader::~FileReader()
 {
-    fclose(mFile);
+    free(mOwned);
 }
 
+void FileReader::read(void* dest, size_t length)
+{
+    // Reading past the end of a truncated file yields zeros
+    size_t avail = mLimit - mCursor;
+    if (length > avail)
+    {
+        if (Ok())
+            mError = "unexpected end of " + mPath;
+        memset((uint8_t*) dest + avail, 0, length - avail);
+        length = avail;
+    }
+    memcpy(dest, mCursor, length);
+    mCursor += length;
+}
 
 uint32_t FileReader::ReadLong()
 {
     uint32_t result;
-    fread((char*)&result, 4, 1, mFile);
+    read(&result, 4);
     if (gLittleEndian)
         reverseBytes((char*)&result, 4);
     return result;
@@ -59,7 +95,7 @@ uint32_t FileReader::ReadLong()
 uint16_t FileReader::ReadWord()
 {
     uint16_t result;
-    fread((char*)&result, 2, 1, mFile);
+    read(&result, 2);
     if (gLittleEndian)
         reverseBytes((char*)&result, 2);
     return result;
@@ -68,15 +104,22 @@ uint16_t FileReader::ReadWord()
 uint8_t FileReader::ReadByte()
 {
     uint8_t result;
-    fread((char*)&result, 1, 1, mFile);
+    read(&result, 1);
     return result;
 }
 
 uint8_t* FileReader::ReadByteArray(int length)
 {
+    // Don't trust a corrupt length to size the allocation
+    size_t avail = mLimit - mCursor;
+    if (length < 0 || (size_t) length > avail)
+    {
+        if (Ok())
+            mError = "unexpected end of " + mPath;
+        length = avail;
+    }
     uint8_t* result = (uint8_t*) malloc(length + 1);
-    fread((char*)result, 1, length, mFile);
+    read(result, length);
     result[length] = 0;
     return result;
 }
-
@@ -4,11 +4,15 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stddef.h>
+
+#include <string>
 
 class FileReader
 {
 public:
     FileReader(const char* path);
+    FileReader(const uint8_t* bytes, size_t length, const char* name);
     ~FileReader();
 
     uint8_t ReadByte();
@@ -16,6 +20,17 @@ public:
     uint16_t ReadWord();
     uint8_t* ReadByteArray(int length);
 
+    bool Ok() const { return mError.empty(); }
+    const std::string& Error() const { return mError; }
+    // Set if the file could not be opened or a read ran off its end.
+
+private:
+    void read(void* dest, size_t length);
+
 private:
-    FILE* mFile;
+    uint8_t*       mOwned;     // file contents, when we read them ourselves
+    const uint8_t* mCursor;
+    const uint8_t* mLimit;
+    std::string    mPath;
+    std::string    mError;
 };
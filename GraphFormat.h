@@ -0,0 +1,91 @@
+// GraphFormat.h
+
+#pragma once
+
+#include "NameStore.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+using std::string;
+
+// The binary graph format is the tab format's content in a compact, canonical
+// form. Every integer is an unsigned LEB128 varint.
+//
+//   magic "JDEPGRF3"
+//   node count
+//   per node, in name order: name, flags (1 = analyzed), class file size
+//     - the name front-coded as NameStore keeps it: the length of the
+//       prefix it shares with the name before, then the length and bytes
+//       of the rest; every NameStore::kBlockSize-th name shares nothing
+//   per node, in name order: edge count, then target ids in increasing order,
+//     each stored as the gap from the previous one
+//   optionally, sections that graph readers ignore: a tag, then its content
+//     - kComponentsSection: per node, its strongly connected component
+const char kGraphMagic[] = "JDEPGRF3";
+const size_t kGraphMagicLength = 8;
+const uint32_t kAnalyzedFlag = 1;
+const uint32_t kComponentsSection = 1;
+
+inline void writeVarint(FILE* outFile, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        putc((value & 0x7f) | 0x80, outFile);
+        value >>= 7;
+    }
+    putc(value, outFile);
+}
+
+inline bool readVarint(FILE* inFile, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        int c = getc(inFile);
+        if (c == EOF)
+            return false;
+        value |= (uint64_t) (c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return true;
+    }
+    return false;
+}
+
+inline bool isBinaryGraph(FILE* inFile)
+{
+    // Leaves inFile rewound either way
+    char magic[kGraphMagicLength];
+    size_t got = fread(magic, 1, kGraphMagicLength, inFile);
+    rewind(inFile);
+    return got == kGraphMagicLength && memcmp(magic, kGraphMagic, kGraphMagicLength) == 0;
+}
+
+inline void writeGraphName(FILE* outFile, uint64_t node, const string& previous,
+                           const char* name, size_t length)
+{
+    size_t shared = 0;
+    if (node % NameStore::kBlockSize != 0)
+    {
+        size_t limit = length < previous.size() ? length : previous.size();
+        while (shared < limit && name[shared] == previous[shared])
+            ++shared;
+    }
+    writeVarint(outFile, shared);
+    writeVarint(outFile, length - shared);
+    fwrite(name + shared, 1, length - shared, outFile);
+}
+
+inline bool readGraphName(FILE* inFile, string& name)
+{
+    // name holds the previous name, which this one builds on
+    uint64_t shared, length;
+    if (!readVarint(inFile, shared) || shared > name.size()
+        || !readVarint(inFile, length) || shared + length > 0xffff)
+        return false;
+    name.resize(shared + length);
+    return fread(&name[0] + shared, 1, length, inFile) == length;
+}
@@ -0,0 +1,23 @@
+// GraphSink.h
+
+#pragma once
+
+#include <stdint.h>
+
+#include <set>
+#include <string>
+
+using std::set;
+using std::string;
+
+// Anything a whole-tree analysis can feed its classes into: the in-memory
+// DependencyGraph, or the ExternalGraph that spills to disk.
+class GraphSink
+{
+public:
+    virtual ~GraphSink() {}
+
+    virtual void AddClass(const string& name, const set<string>& deps, uint64_t size = 0) = 0;
+    // Records name as analyzed, with an edge to each of deps. size is the
+    // total size of its class files, inner classes included.
+};
@@ -0,0 +1,178 @@
+// HotspotReport.cpp
+
+#include "HotspotReport.h"
+
+#include <algorithm>
+#include <inttypes.h>
+
+// Bound on the reachability bitmaps, which cover as many target components
+// per pass as fit in this many bytes.
+const size_t kMaskBudget = 64 << 20;
+
+HotspotReport::HotspotReport(const DependencyGraph& graph)
+    : mGraph(graph)
+    , mEntries(graph.NodeCount())
+{
+    countDirect();
+    countTransitive();
+}
+
+void HotspotReport::countDirect()
+{
+    for (NodeId node = 0; node < mGraph.NodeCount(); ++node)
+    {
+        vector<NodeId> deps(mGraph.Deps(node));
+        std::sort(deps.begin(), deps.end());
+        deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+        for (size_t i = 0; i < deps.size(); ++i)
+        {
+            if (deps[i] == node)
+                continue;
+            ++mEntries[node].directOut;
+            ++mEntries[deps[i]].directIn;
+        }
+    }
+}
+
+void HotspotReport::countTransitive()
+{
+    // Every class in a cycle invalidates every other, so work on the graph
+    // of strongly connected components, which is acyclic.
+    size_t count = mGraph.StronglyConnectedComponents(mComponent);
+    mMembers.assign(count, 0);
+    mSizes.assign(count, 0);
+    mDepsOf.assign(count, vector<uint32_t>());
+    mDependentsOf.assign(count, vector<uint32_t>());
+    for (NodeId node = 0; node < mGraph.NodeCount(); ++node)
+    {
+        uint32_t from = mComponent[node];
+        ++mMembers[from];
+        mSizes[from] += mGraph.Size(node);
+        const vector<NodeId>& deps = mGraph.Deps(node);
+        for (size_t i = 0; i < deps.size(); ++i)
+        {
+            uint32_t to = mComponent[deps[i]];
+            if (to != from)
+                mDepsOf[from].push_back(to);
+        }
+    }
+    for (uint32_t from = 0; from < count; ++from)
+    {
+        vector<uint32_t>& deps = mDepsOf[from];
+        std::sort(deps.begin(), deps.end());
+        deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+        for (size_t i = 0; i < deps.size(); ++i)
+            mDependentsOf[deps[i]].push_back(from);
+    }
+
+    // Components are numbered so that dependencies come first: a component's
+    // fan-out builds on lower numbered ones, its fan-in on higher ones.
+    vector<uint64_t> reachedIn, weightIn, reachedOut;
+    propagate(mDependentsOf, false, reachedIn, &weightIn);
+    propagate(mDepsOf, true, reachedOut, 0);
+
+    for (NodeId node = 0; node < mGraph.NodeCount(); ++node)
+    {
+        uint32_t c = mComponent[node];
+        Entry& entry = mEntries[node];
+        entry.transitiveIn = reachedIn[c] + mMembers[c] - 1;
+        entry.weightedIn = weightIn[c] + mSizes[c] - mGraph.Size(node);
+        entry.transitiveOut = reachedOut[c] + mMembers[c] - 1;
+    }
+}
+
+void HotspotReport::propagate(const vector<vector<uint32_t> >& edges, bool ascending,
+                              vector<uint64_t>& reached, vector<uint64_t>* weight) const
+{
+    // Exact transitive counts need the actual reachable sets, so build them
+    // as bitmaps over a window of target components at a time, each
+    // component inheriting the bits of the components along its edges.
+    size_t count = edges.size();
+    reached.assign(count, 0);
+    if (weight)
+        weight->assign(count, 0);
+    if (count == 0)
+        return;
+
+    size_t words = (count + 63) / 64;
+    words = std::min(words, std::max((size_t) 1, kMaskBudget / (8 * count)));
+    size_t window = words * 64;
+    vector<uint64_t> masks(count * words);
+
+    for (size_t first = 0; first < count; first += window)
+    {
+        size_t last = std::min(count, first + window);
+        std::fill(masks.begin(), masks.end(), 0);
+
+        // Only components on the far side of the window can reach into it
+        size_t begin = ascending ? first : last - 1;
+        size_t end = ascending ? count : (size_t) -1;
+        for (size_t c = begin; c != end; ascending ? ++c : --c)
+        {
+            uint64_t* mask = &masks[c * words];
+            const vector<uint32_t>& next = edges[c];
+            for (size_t i = 0; i < next.size(); ++i)
+            {
+                size_t t = next[i];
+                if (t >= first && t < last)
+                    mask[(t - first) / 64] |= (uint64_t) 1 << ((t - first) % 64);
+                const uint64_t* inherited = &masks[t * words];
+                for (size_t w = 0; w < words; ++w)
+                    mask[w] |= inherited[w];
+            }
+
+            for (size_t w = 0; w < words; ++w)
+            {
+                uint64_t bits = mask[w];
+                while (bits)
+                {
+                    size_t t = first + w * 64 + __builtin_ctzll(bits);
+                    bits &= bits - 1;
+                    reached[c] += mMembers[t];
+                    if (weight)
+                        (*weight)[c] += mSizes[t];
+                }
+            }
+        }
+    }
+}
+
+void HotspotReport::Write(FILE* outFile) const
+{
+    vector<NodeId> order(mGraph.NodeCount());
+    for (NodeId node = 0; node < order.size(); ++node)
+        order[node] = node;
+
+    vector<uint32_t> rank;
+    mGraph.NameRanks(rank);
+
+    struct CostOrder
+    {
+        const HotspotReport*    report;
+        const vector<uint32_t>& rank;
+
+        bool operator()(NodeId a, NodeId b) const
+        {
+            const Entry& ea = report->mEntries[a];
+            const Entry& eb = report->mEntries[b];
+            if (ea.weightedIn != eb.weightedIn)
+                return ea.weightedIn > eb.weightedIn;
+            if (ea.transitiveIn != eb.transitiveIn)
+                return ea.transitiveIn > eb.transitiveIn;
+            return rank[a] < rank[b];
+        }
+    };
+    CostOrder costOrder = { this, rank };
+    std::sort(order.begin(), order.end(), costOrder);
+
+    fprintf(outFile, "# weighted_in\ttransitive_in\tdirect_in\ttransitive_out\tdirect_out\tsize\tclass\n");
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        NodeId node = order[i];
+        const Entry& entry = mEntries[node];
+        fprintf(outFile, "%" PRIu64 "\t%" PRIu64 "\t%u\t%" PRIu64 "\t%u\t%" PRIu64 "\t%s\n",
+                entry.weightedIn, entry.transitiveIn, entry.directIn,
+                entry.transitiveOut, entry.directOut, mGraph.Size(node),
+                mGraph.Name(node).c_str());
+    }
+}
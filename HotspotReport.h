@@ -0,0 +1,47 @@
+// HotspotReport.h
+
+#pragma once
+
+#include "DependencyGraph.h"
+
+#include <stdio.h>
+
+// Ranks the classes of a dependency graph by how much recompilation a change
+// to each one would cause: the classes that transitively depend on it,
+// weighted by the size of their class files as a proxy for compile cost.
+class HotspotReport
+{
+public:
+    HotspotReport(const DependencyGraph& graph);
+
+    void Write(FILE* outFile) const;
+    // One line per class, costliest first.
+
+private:
+    typedef DependencyGraph::NodeId NodeId;
+
+    struct Entry
+    {
+        uint32_t directIn;       // classes that name it directly
+        uint32_t directOut;      // classes it names directly
+        uint64_t transitiveIn;   // classes that depend on it at any remove
+        uint64_t transitiveOut;  // classes it depends on at any remove
+        uint64_t weightedIn;     // total size of the transitiveIn classes
+    };
+
+    void countDirect();
+    void countTransitive();
+    void propagate(const vector<vector<uint32_t> >& edges, bool ascending,
+                   vector<uint64_t>& reached, vector<uint64_t>* weight) const;
+
+private:
+    const DependencyGraph& mGraph;
+    vector<Entry>          mEntries;
+
+    // The graph condensed to its strongly connected components
+    vector<uint32_t>          mComponent;     // component of each node
+    vector<uint32_t>          mMembers;       // node count of each component
+    vector<uint64_t>          mSizes;         // total size of each component
+    vector<vector<uint32_t> > mDepsOf;        // component -> components it uses
+    vector<vector<uint32_t> > mDependentsOf;  // component -> components using it
+};
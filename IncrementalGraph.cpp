@@ -0,0 +1,379 @@
+// IncrementalGraph.cpp
+
+#include "IncrementalGraph.h"
+#include "GraphFormat.h"
+
+#include <errno.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+#include <unordered_set>
+
+using std::unordered_map;
+using std::unordered_set;
+
+IncrementalGraph::IncrementalGraph()
+    : mLastChanged(false)
+{
+}
+
+bool IncrementalGraph::Load(const string& path)
+{
+    FILE* inFile = fopen(path.c_str(), "rb");
+    if (!inFile)
+    {
+        // The first run has nothing to start from
+        if (errno == ENOENT)
+            return true;
+        mError = "unable to open graph file " + path;
+        return false;
+    }
+
+    bool binary = isBinaryGraph(inFile);
+    bool ok = binary ? mGraph.ReadBinary(inFile) : mGraph.ReadTabular(inFile);
+    if (!ok)
+        mError = mGraph.Error();
+    else if (binary)
+        ok = readComponents(inFile);
+    fclose(inFile);
+    if (!ok)
+    {
+        mError += " in " + path;
+        return false;
+    }
+
+    // Edge lists must be sorted to diff against; bin graphs already are
+    if (!binary)
+        mGraph.Canonicalize();
+    if (mComponent.empty())
+        mGraph.StronglyConnectedComponents(mComponent);
+    indexMembers();
+    return true;
+}
+
+bool IncrementalGraph::readComponents(FILE* inFile)
+{
+    // Sections follow the graph until the end of the file. One we do not
+    // know ends the part we can read.
+    uint64_t tag;
+    while (readVarint(inFile, tag) && tag == kComponentsSection)
+    {
+        size_t count = mGraph.NodeCount();
+        mComponent.resize(count);
+        for (NodeId node = 0; node < count; ++node)
+        {
+            uint64_t label;
+            if (!readVarint(inFile, label) || label >= count)
+            {
+                mComponent.clear();
+                mError = "corrupt component section";
+                return false;
+            }
+            mComponent[node] = label;
+        }
+    }
+    return true;
+}
+
+void IncrementalGraph::indexMembers()
+{
+    uint32_t count = 0;
+    for (size_t node = 0; node < mComponent.size(); ++node)
+        count = std::max(count, mComponent[node] + 1);
+    mMembers.assign(count, vector<NodeId>());
+    for (NodeId node = 0; node < mComponent.size(); ++node)
+        mMembers[mComponent[node]].push_back(node);
+}
+
+bool IncrementalGraph::Save(const string& path)
+{
+    vector<NodeId> remap;
+    mGraph.Canonicalize(&remap);
+
+    // Renumber the labels densely, in order of each one's first member, so
+    // that the same graph always saves the same bytes.
+    const uint32_t kUnassigned = UINT32_MAX;
+    vector<uint32_t> component(mComponent.size());
+    for (NodeId node = 0; node < mComponent.size(); ++node)
+        component[remap[node]] = mComponent[node];
+    vector<uint32_t> relabel(mMembers.size(), kUnassigned);
+    uint32_t labels = 0;
+    for (NodeId node = 0; node < component.size(); ++node)
+    {
+        uint32_t& label = relabel[component[node]];
+        if (label == kUnassigned)
+            label = labels++;
+        component[node] = label;
+    }
+    mComponent.swap(component);
+    indexMembers();
+
+    set<uint32_t> changed;
+    for (set<uint32_t>::iterator it = mChangedLabels.begin(); it != mChangedLabels.end(); ++it)
+    {
+        if (relabel[*it] != kUnassigned)
+            changed.insert(relabel[*it]);
+    }
+    mChangedLabels.swap(changed);
+
+    string temporary = path + ".tmp";
+    FILE* outFile = fopen(temporary.c_str(), "wb");
+    if (!outFile)
+    {
+        mError = "unable to open graph file " + temporary;
+        return false;
+    }
+    mGraph.WriteBinary(outFile);
+    writeVarint(outFile, kComponentsSection);
+    for (NodeId node = 0; node < mComponent.size(); ++node)
+        writeVarint(outFile, mComponent[node]);
+    if (fclose(outFile) != 0 || rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        remove(temporary.c_str());
+        mError = "error writing graph file " + path;
+        return false;
+    }
+    return true;
+}
+
+IncrementalGraph::NodeId IncrementalGraph::addNode(const string& name)
+{
+    NodeId node = mGraph.AddNode(name);
+    if (node == mComponent.size())
+    {
+        uint32_t label = newComponent();
+        mComponent.push_back(label);
+        mMembers[label].push_back(node);
+    }
+    return node;
+}
+
+uint32_t IncrementalGraph::newComponent()
+{
+    mMembers.push_back(vector<NodeId>());
+    return mMembers.size() - 1;
+}
+
+void IncrementalGraph::AddClass(const string& name, const set<string>& deps, uint64_t size)
+{
+    NodeId node = addNode(name);
+    vector<NodeId> targets;
+    for (set<string>::const_iterator it = deps.begin(); it != deps.end(); ++it)
+        targets.push_back(addNode(*it));
+    std::sort(targets.begin(), targets.end());
+
+    const vector<NodeId>& previous = mGraph.Deps(node);
+    vector<NodeId> removed, added;
+    std::set_difference(previous.begin(), previous.end(), targets.begin(), targets.end(),
+                        std::back_inserter(removed));
+    std::set_difference(targets.begin(), targets.end(), previous.begin(), previous.end(),
+                        std::back_inserter(added));
+
+    dropEdges(node, removed);
+    for (size_t i = 0; i < added.size(); ++i)
+        mInserted.push_back(Edge(node, added[i]));
+
+    mLastChanged = !mGraph.IsAnalyzed(node) || !removed.empty() || !added.empty();
+    if (mLastChanged)
+        mChangedClasses.push_back(name);
+    nameAll(removed, mLastRemoved);
+    nameAll(added, mLastAdded);
+    mGraph.SetClass(node, targets, size);
+}
+
+void IncrementalGraph::RemoveClass(const string& name)
+{
+    NodeId node;
+    mLastChanged = mGraph.Find(name, node) && mGraph.IsAnalyzed(node);
+    mLastRemoved.clear();
+    mLastAdded.clear();
+    if (!mLastChanged)
+        return;
+    nameAll(mGraph.Deps(node), mLastRemoved);
+    dropEdges(node, mGraph.Deps(node));
+    mGraph.RemoveClass(node);
+    mRemovedClasses.push_back(name);
+}
+
+void IncrementalGraph::nameAll(const vector<NodeId>& nodes, vector<string>& names) const
+{
+    names.clear();
+    for (size_t i = 0; i < nodes.size(); ++i)
+        names.push_back(mGraph.Name(nodes[i]));
+    std::sort(names.begin(), names.end());
+}
+
+void IncrementalGraph::dropEdges(NodeId node, const vector<NodeId>& removed)
+{
+    // Only an edge inside a component can hold a cycle together
+    for (size_t i = 0; i < removed.size(); ++i)
+    {
+        if (mComponent[removed[i]] == mComponent[node])
+            mSplits.insert(mComponent[node]);
+    }
+}
+
+void IncrementalGraph::Update()
+{
+    // A component that lost an internal edge can only fall apart, and only
+    // into pieces of itself, so its members alone are recomputed.
+    for (set<uint32_t>::iterator it = mSplits.begin(); it != mSplits.end(); ++it)
+    {
+        vector<NodeId> members = mMembers[*it];
+        recompute(members);
+    }
+
+    // Any cycle a new edge closes runs from its target back to its source,
+    // so lies among the classes the targets reach. Those are recomputed
+    // together in one pass, whatever the number of new edges.
+    vector<NodeId> reached;
+    unordered_set<NodeId> seen;
+    for (size_t i = 0; i < mInserted.size(); ++i)
+    {
+        // A class analyzed twice may since have lost the edge again
+        NodeId from = mInserted[i].first;
+        NodeId to = mInserted[i].second;
+        const vector<NodeId>& deps = mGraph.Deps(from);
+        if (mComponent[from] != mComponent[to]
+            && std::binary_search(deps.begin(), deps.end(), to)
+            && seen.insert(to).second)
+            reached.push_back(to);
+    }
+    for (size_t i = 0; i < reached.size(); ++i)
+    {
+        const vector<NodeId>& deps = mGraph.Deps(reached[i]);
+        for (size_t d = 0; d < deps.size(); ++d)
+        {
+            if (seen.insert(deps[d]).second)
+                reached.push_back(deps[d]);
+        }
+    }
+    if (!reached.empty())
+        recompute(reached);
+
+    mSplits.clear();
+    mInserted.clear();
+}
+
+void IncrementalGraph::recompute(const vector<NodeId>& nodes)
+{
+    // Tarjan's algorithm, as in DependencyGraph, over just nodes and the
+    // edges among them. nodes must hold whole components.
+    size_t count = nodes.size();
+    unordered_map<NodeId, uint32_t> position;
+    for (uint32_t i = 0; i < count; ++i)
+        position[nodes[i]] = i;
+
+    const uint32_t kUnvisited = UINT32_MAX;
+    vector<uint32_t> index(count, kUnvisited);
+    vector<uint32_t> lowLink(count);
+    vector<uint32_t> local(count);
+    vector<bool> onStack(count, false);
+    vector<uint32_t> stack;
+    vector<std::pair<uint32_t, size_t> > frames;   // position, next edge to follow
+    uint32_t nextIndex = 0;
+    uint32_t components = 0;
+
+    for (uint32_t root = 0; root < count; ++root)
+    {
+        if (index[root] != kUnvisited)
+            continue;
+        frames.push_back(std::make_pair(root, 0));
+        index[root] = lowLink[root] = nextIndex++;
+        stack.push_back(root);
+        onStack[root] = true;
+
+        while (!frames.empty())
+        {
+            uint32_t node = frames.back().first;
+            size_t& edge = frames.back().second;
+            const vector<NodeId>& deps = mGraph.Deps(nodes[node]);
+            if (edge < deps.size())
+            {
+                unordered_map<NodeId, uint32_t>::iterator it = position.find(deps[edge++]);
+                if (it == position.end())
+                    continue;
+                uint32_t next = it->second;
+                if (index[next] == kUnvisited)
+                {
+                    index[next] = lowLink[next] = nextIndex++;
+                    stack.push_back(next);
+                    onStack[next] = true;
+                    frames.push_back(std::make_pair(next, 0));
+                }
+                else if (onStack[next])
+                    lowLink[node] = std::min(lowLink[node], index[next]);
+                continue;
+            }
+
+            if (lowLink[node] == index[node])
+            {
+                uint32_t member;
+                do
+                {
+                    member = stack.back();
+                    stack.pop_back();
+                    onStack[member] = false;
+                    local[member] = components;
+                } while (member != node);
+                ++components;
+            }
+            frames.pop_back();
+            if (!frames.empty())
+            {
+                uint32_t parent = frames.back().first;
+                lowLink[parent] = std::min(lowLink[parent], lowLink[node]);
+            }
+        }
+    }
+
+    // A component made of exactly one old label's members is unchanged. Any
+    // other is new, and retires every label it draws members from, since no
+    // part of those can have stayed whole.
+    vector<vector<uint32_t> > groups(components);
+    for (uint32_t i = 0; i < count; ++i)
+        groups[local[i]].push_back(i);
+    for (uint32_t c = 0; c < components; ++c)
+    {
+        const vector<uint32_t>& group = groups[c];
+        uint32_t label = mComponent[nodes[group[0]]];
+        bool same = mMembers[label].size() == group.size();
+        for (size_t i = 1; same && i < group.size(); ++i)
+            same = mComponent[nodes[group[i]]] == label;
+        if (same)
+            continue;
+
+        for (size_t i = 0; i < group.size(); ++i)
+        {
+            uint32_t old = mComponent[nodes[group[i]]];
+            mMembers[old].clear();
+            mChangedLabels.erase(old);
+        }
+        label = newComponent();
+        for (size_t i = 0; i < group.size(); ++i)
+        {
+            mComponent[nodes[group[i]]] = label;
+            mMembers[label].push_back(nodes[group[i]]);
+        }
+        mChangedLabels.insert(label);
+    }
+}
+
+vector<vector<string> > IncrementalGraph::ChangedGroups() const
+{
+    vector<vector<string> > groups;
+    for (set<uint32_t>::const_iterator it = mChangedLabels.begin(); it != mChangedLabels.end(); ++it)
+    {
+        const vector<NodeId>& members = mMembers[*it];
+        if (members.empty())
+            continue;
+        groups.push_back(vector<string>());
+        for (size_t i = 0; i < members.size(); ++i)
+            groups.back().push_back(mGraph.Name(members[i]));
+        std::sort(groups.back().begin(), groups.back().end());
+    }
+    std::sort(groups.begin(), groups.end());
+    return groups;
+}
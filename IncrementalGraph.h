@@ -0,0 +1,92 @@
+// IncrementalGraph.h
+
+#pragma once
+
+#include "DependencyGraph.h"
+
+#include <stdint.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+using std::set;
+using std::string;
+using std::vector;
+
+// A whole-tree graph kept from one run to the next together with its strongly
+// connected components, so that a run which re-analyzes only the classes that
+// changed can patch both instead of rebuilding them. Components that lose an
+// internal edge are recomputed on their own members, and new edges over just
+// the classes their targets reach.
+class IncrementalGraph : public GraphSink
+{
+public:
+    typedef DependencyGraph::NodeId NodeId;
+
+    IncrementalGraph();
+
+    bool Load(const string& path);
+    // Reads a graph saved by Save. A missing file is an empty graph, and a
+    // graph without components, as -f bin writes, has them computed once.
+    // Returns false, leaving the reason in Error(), on failure.
+
+    bool Save(const string& path);
+    // Writes the graph and its components in bin format, replacing path only
+    // once the new file is complete. Call Update first.
+
+    void AddClass(const string& name, const set<string>& deps, uint64_t size = 0);
+    // Replaces the edges of name with deps.
+
+    void RemoveClass(const string& name);
+    // Drops the edges of a class whose class file is gone.
+
+    bool LastChanged() const { return mLastChanged; }
+    // Whether the last AddClass or RemoveClass changed the class's edges, so
+    // that its per-class output needs rewriting or removing.
+
+    const vector<string>& LastRemoved() const { return mLastRemoved; }
+    const vector<string>& LastAdded() const { return mLastAdded; }
+    // The dependencies the last AddClass or RemoveClass took away from and
+    // gave to the class, each in name order.
+
+    void Update();
+    // Brings the components up to date with every change since the last call.
+
+    const vector<string>& ChangedClasses() const { return mChangedClasses; }
+    const vector<string>& RemovedClasses() const { return mRemovedClasses; }
+
+    vector<vector<string> > ChangedGroups() const;
+    // The components that Update split or merged, each as its member names
+    // in order. Classes in one component must be compiled together.
+
+    const DependencyGraph& Graph() const { return mGraph; }
+
+    const string& Error() const { return mError; }
+
+private:
+    typedef std::pair<NodeId, NodeId> Edge;
+
+    NodeId addNode(const string& name);
+    uint32_t newComponent();
+    void dropEdges(NodeId node, const vector<NodeId>& removed);
+    void nameAll(const vector<NodeId>& nodes, vector<string>& names) const;
+    void recompute(const vector<NodeId>& nodes);
+
+    bool readComponents(FILE* inFile);
+    void indexMembers();
+
+private:
+    DependencyGraph         mGraph;
+    vector<uint32_t>        mComponent;     // label of each node
+    vector<vector<NodeId> > mMembers;       // nodes of each label; empty once retired
+    set<uint32_t>           mSplits;        // labels that lost an internal edge
+    vector<Edge>            mInserted;      // edges added since the last Update
+    set<uint32_t>           mChangedLabels; // labels Update created
+    vector<string>          mChangedClasses;
+    vector<string>          mRemovedClasses;
+    bool                    mLastChanged;
+    vector<string>          mLastRemoved;
+    vector<string>          mLastAdded;
+    string                  mError;
+};
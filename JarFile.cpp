@@ -0,0 +1,193 @@
+// JarFile.cpp
+
+#include "JarFile.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+// Zip records are little-endian regardless of the host.
+static uint16_t zipWord(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t zipLong(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+const uint32_t kLocalHeaderSig      = 0x04034b50;
+const uint32_t kCentralHeaderSig    = 0x02014b50;
+const uint32_t kEndOfCentralDirSig  = 0x06054b50;
+const uint32_t kZip64LocatorSig     = 0x07064b50;
+const size_t   kLocalHeaderSize     = 30;
+const size_t   kCentralHeaderSize   = 46;
+const size_t   kEndOfCentralDirSize = 22;
+const size_t   kZip64LocatorSize    = 20;
+
+// A field at its maximum means the real value is in a ZIP64 record.
+const uint16_t kZip64Count = 0xffff;
+const uint32_t kZip64Long  = 0xffffffff;
+
+const uint16_t kMethodStored   = 0;
+const uint16_t kMethodDeflated = 8;
+
+JarFile::JarFile(const string& path)
+    : mPath(path)
+    , mFd(open(path.c_str(), O_RDONLY))
+    , mData(0)
+    , mLength(0)
+{
+    struct stat st;
+    if (mFd < 0 || fstat(mFd, &st) < 0)
+    {
+        mError = "unable to open jar file " + path;
+        return;
+    }
+    mLength = st.st_size;
+    if (mLength > 0)
+    {
+        void* data = mmap(0, mLength, PROT_READ, MAP_PRIVATE, mFd, 0);
+        if (data == MAP_FAILED)
+        {
+            mError = "unable to map jar file " + path;
+            return;
+        }
+        mData = (const uint8_t*) data;
+    }
+    if (!readCentralDirectory())
+        mEntries.clear();
+}
+
+JarFile::~JarFile()
+{
+    if (mData)
+        munmap((void*) mData, mLength);
+    if (mFd >= 0)
+        close(mFd);
+}
+
+bool JarFile::readCentralDirectory()
+{
+    // The end of central directory record is the last thing in the file,
+    // followed by a comment of at most 64K.
+    if (mLength < kEndOfCentralDirSize)
+    {
+        mError = mPath + " is not a jar file";
+        return false;
+    }
+    const uint8_t* end = 0;
+    size_t lowest = mLength > kEndOfCentralDirSize + 0xffff ? mLength - kEndOfCentralDirSize - 0xffff : 0;
+    for (size_t pos = mLength - kEndOfCentralDirSize; ; --pos)
+    {
+        if (zipLong(mData + pos) == kEndOfCentralDirSig)
+        {
+            end = mData + pos;
+            break;
+        }
+        if (pos == lowest)
+            break;
+    }
+    if (!end)
+    {
+        mError = mPath + " is not a jar file";
+        return false;
+    }
+
+    uint16_t count = zipWord(end + 10);
+    uint32_t offset = zipLong(end + 16);
+    if (count == kZip64Count || offset == kZip64Long
+        || (end - mData >= (long) kZip64LocatorSize
+            && zipLong(end - kZip64LocatorSize) == kZip64LocatorSig))
+    {
+        mError = "ZIP64 jars are not supported: " + mPath;
+        return false;
+    }
+    if (offset > (size_t) (end - mData))
+    {
+        mError = "corrupt central directory in " + mPath;
+        return false;
+    }
+    const uint8_t* cursor = mData + offset;
+    const uint8_t* limit = end;
+    mEntries.reserve(count);
+    for (int i = 0; i < count; ++i)
+    {
+        if (limit - cursor < (long) kCentralHeaderSize || zipLong(cursor) != kCentralHeaderSig)
+        {
+            mError = "corrupt central directory in " + mPath;
+            return false;
+        }
+        uint16_t nameLength = zipWord(cursor + 28);
+        uint16_t extraLength = zipWord(cursor + 30);
+        uint16_t commentLength = zipWord(cursor + 32);
+        size_t recordSize = kCentralHeaderSize + nameLength + extraLength + commentLength;
+        if (recordSize > (size_t) (limit - cursor))
+        {
+            mError = "corrupt central directory in " + mPath;
+            return false;
+        }
+
+        Entry entry;
+        entry.method = zipWord(cursor + 10);
+        entry.compressedSize = zipLong(cursor + 20);
+        entry.size = zipLong(cursor + 24);
+        entry.localHeaderOffset = zipLong(cursor + 42);
+        if (entry.compressedSize == kZip64Long || entry.size == kZip64Long
+            || entry.localHeaderOffset == kZip64Long)
+        {
+            mError = "ZIP64 jars are not supported: " + mPath;
+            return false;
+        }
+        entry.name.assign((const char*) cursor + kCentralHeaderSize, nameLength);
+        mEntries.push_back(entry);
+
+        cursor += recordSize;
+    }
+    return true;
+}
+
+bool JarFile::Extract(size_t index, vector<uint8_t>& bytes) const
+{
+    const Entry& entry = mEntries[index];
+    size_t offset = entry.localHeaderOffset;
+    if (offset + kLocalHeaderSize > mLength || zipLong(mData + offset) != kLocalHeaderSig)
+        return false;
+
+    // The local header's name and extra fields need not match the central
+    // directory's, so the data offset has to come from the local header.
+    size_t dataOffset = offset + kLocalHeaderSize + zipWord(mData + offset + 26)
+        + zipWord(mData + offset + 28);
+    if (dataOffset + entry.compressedSize > mLength)
+        return false;
+    const uint8_t* data = mData + dataOffset;
+
+    bytes.resize(entry.size);
+    if (entry.size == 0)
+        return true;
+    if (entry.method == kMethodStored)
+    {
+        if (entry.compressedSize != entry.size)
+            return false;
+        memcpy(bytes.data(), data, entry.size);
+        return true;
+    }
+    if (entry.method != kMethodDeflated)
+        return false;
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+        return false;
+    stream.next_in = (Bytef*) data;
+    stream.avail_in = entry.compressedSize;
+    stream.next_out = bytes.data();
+    stream.avail_out = entry.size;
+    int status = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    return status == Z_STREAM_END && stream.total_out == entry.size;
+}
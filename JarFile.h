@@ -0,0 +1,53 @@
+// JarFile.h
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+class JarFile
+{
+public:
+    JarFile(const string& path);
+    ~JarFile();
+
+    const string& Path() const { return mPath; }
+
+    bool Ok() const { return mError.empty(); }
+    const string& Error() const { return mError; }
+    // Set if the archive could not be opened or its directory is corrupt.
+
+    size_t EntryCount() const { return mEntries.size(); }
+
+    const string& EntryName(size_t index) const { return mEntries[index].name; }
+
+    bool Extract(size_t index, vector<uint8_t>& bytes) const;
+    // Fills bytes with the uncompressed contents of the entry.
+    // Returns false if the entry is corrupt or uses an unsupported method.
+
+private:
+    struct Entry
+    {
+        string   name;
+        uint16_t method;
+        uint32_t compressedSize;
+        uint32_t size;
+        uint32_t localHeaderOffset;
+    };
+
+    bool readCentralDirectory();
+
+private:
+    string         mPath;
+    int            mFd;
+    const uint8_t* mData;
+    size_t         mLength;
+    vector<Entry>  mEntries;
+    string         mError;
+};
@@ -0,0 +1,124 @@
+// Jobserver.cpp
+
+#include "Jobserver.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <unistd.h>
+
+Jobserver::Jobserver()
+    : mReadFd(-1)
+    , mWriteFd(-1)
+    , mOwnRead(false)
+{
+}
+
+Jobserver::~Jobserver()
+{
+    while (!mTokens.empty())
+        Release();
+    close();
+}
+
+bool Jobserver::Connect(const string& makeflags)
+{
+    // make appends the option, so a later one overrides an earlier
+    static const char* const kOptions[] = { "--jobserver-auth=", "--jobserver-fds=" };
+    size_t best = string::npos;
+    size_t start = 0;
+    for (size_t i = 0; i < sizeof(kOptions) / sizeof(kOptions[0]); ++i)
+    {
+        size_t found = makeflags.rfind(kOptions[i]);
+        if (found != string::npos && (best == string::npos || found > best))
+        {
+            best = found;
+            start = found + string(kOptions[i]).size();
+        }
+    }
+    if (best == string::npos)
+        return false;
+
+    size_t end = makeflags.find(' ', start);
+    string auth = makeflags.substr(start, end == string::npos ? string::npos : end - start);
+    if (auth.compare(0, 5, "fifo:") == 0)
+        return connectFifo(auth.substr(5));
+
+    int readFd, writeFd;
+    char extra;
+    if (sscanf(auth.c_str(), "%d,%d%c", &readFd, &writeFd, &extra) != 2)
+        return false;
+    return connectPipe(readFd, writeFd);
+}
+
+bool Jobserver::connectPipe(int readFd, int writeFd)
+{
+    // make closes its pipe for recipes it does not know run make, and the
+    // numbers may then name unrelated files, or nothing
+    if (readFd < 0 || writeFd < 0 || fcntl(readFd, F_GETFD) < 0 || fcntl(writeFd, F_GETFD) < 0)
+        return false;
+
+    // Reads must not block: another process can take the token that poll
+    // saw. The pipe is shared with make and every other job, so rather than
+    // change its flags, open it afresh, non-blocking, where the system allows.
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", readFd);
+    int ownFd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    mReadFd = ownFd >= 0 ? ownFd : readFd;
+    mOwnRead = ownFd >= 0;
+    mWriteFd = writeFd;
+    return true;
+}
+
+bool Jobserver::connectFifo(const string& path)
+{
+    int fd = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    mReadFd = mWriteFd = fd;
+    mOwnRead = true;
+    return true;
+}
+
+void Jobserver::close()
+{
+    // A fifo is read and written through the one descriptor
+    if (mOwnRead)
+        ::close(mReadFd);
+    mReadFd = mWriteFd = -1;
+    mOwnRead = false;
+}
+
+bool Jobserver::Acquire(int timeoutMs)
+{
+    if (!Connected())
+        return false;
+
+    struct pollfd ready;
+    ready.fd = mReadFd;
+    ready.events = POLLIN;
+    if (poll(&ready, 1, timeoutMs) <= 0)
+        return false;
+
+    char token;
+    if (read(mReadFd, &token, 1) != 1)
+        return false;
+    std::lock_guard<std::mutex> hold(mLock);
+    mTokens.push_back(token);
+    return true;
+}
+
+void Jobserver::Release()
+{
+    char token;
+    {
+        std::lock_guard<std::mutex> hold(mLock);
+        if (mTokens.empty())
+            return;
+        token = mTokens.back();
+        mTokens.pop_back();
+    }
+    while (write(mWriteFd, &token, 1) < 0 && errno == EINTR)
+        ;
+}
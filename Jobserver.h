@@ -0,0 +1,50 @@
+// Jobserver.h
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// A client of GNU make's jobserver, through which every job that make -jN
+// runs shares its N slots. Each slot is a token: a byte in a pipe or named
+// fifo. A job holds one token implicitly, and must take another from the
+// jobserver for each thread it runs beyond its first, giving it back after.
+class Jobserver
+{
+public:
+    Jobserver();
+    ~Jobserver();
+    // Gives back any tokens still held.
+
+    bool Connect(const string& makeflags);
+    // Finds the jobserver named in makeflags, as make passes it in MAKEFLAGS:
+    // --jobserver-auth=R,W (or --jobserver-fds=R,W, from make before 4.2)
+    // for an inherited pipe, or --jobserver-auth=fifo:PATH for a named fifo.
+    // Returns false if there is none, or if make did not let us inherit its
+    // pipe, as it does only for recipes it knows run make (marked with '+').
+
+    bool Connected() const { return mReadFd >= 0; }
+
+    bool Acquire(int timeoutMs);
+    // Takes a token, waiting at most timeoutMs for one. Returns false if none
+    // came free in time. Safe to call from any thread.
+
+    void Release();
+    // Gives back a token taken by Acquire.
+
+private:
+    bool connectPipe(int readFd, int writeFd);
+    bool connectFifo(const string& path);
+    void close();
+
+private:
+    int          mReadFd;
+    int          mWriteFd;
+    bool         mOwnRead;      // opened by us, so ours to close
+    vector<char> mTokens;       // held, to give back as they were taken
+    std::mutex   mLock;
+};
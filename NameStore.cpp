@@ -0,0 +1,134 @@
+// NameStore.cpp
+
+#include "NameStore.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+// Each name is the varint length of the prefix it shares with the one
+// before, the varint length of the rest, and the rest
+static void appendVarint(vector<uint8_t>& data, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        data.push_back((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    data.push_back(value);
+}
+
+static uint64_t decodeVarint(const uint8_t* data, size_t& pos)
+{
+    uint64_t value = 0;
+    for (int shift = 0; ; shift += 7)
+    {
+        uint8_t c = data[pos++];
+        value |= (uint64_t) (c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return value;
+    }
+}
+
+NameStore::NameStore()
+    : mCount(0)
+{
+}
+
+void NameStore::Append(const string& name)
+{
+    size_t shared = 0;
+    if (mCount % kBlockSize == 0)
+        mBlocks.push_back(mData.size());
+    else
+    {
+        size_t limit = std::min(name.size(), mLast.size());
+        while (shared < limit && name[shared] == mLast[shared])
+            ++shared;
+    }
+    appendVarint(mData, shared);
+    appendVarint(mData, name.size() - shared);
+    mData.insert(mData.end(), name.begin() + shared, name.end());
+    mLast = name;
+    ++mCount;
+}
+
+size_t NameStore::decode(size_t pos, string& name) const
+{
+    size_t shared = decodeVarint(mData.data(), pos);
+    size_t rest = decodeVarint(mData.data(), pos);
+    name.resize(shared);
+    name.append((const char*) mData.data() + pos, rest);
+    return pos + rest;
+}
+
+string NameStore::Get(size_t index) const
+{
+    string name;
+    size_t pos = mBlocks[index / kBlockSize];
+    for (size_t i = index - index % kBlockSize; i <= index; ++i)
+        pos = decode(pos, name);
+    return name;
+}
+
+int NameStore::compareHead(size_t block, const string& name) const
+{
+    size_t pos = mBlocks[block];
+    decodeVarint(mData.data(), pos);       // shares nothing
+    size_t length = decodeVarint(mData.data(), pos);
+    int cmp = memcmp(mData.data() + pos, name.data(), std::min(length, name.size()));
+    if (cmp != 0)
+        return cmp;
+    return length < name.size() ? -1 : length > name.size() ? 1 : 0;
+}
+
+bool NameStore::Find(const string& name, size_t& index) const
+{
+    if (mCount == 0 || name > mLast)
+        return false;
+
+    // The last block whose first name is not after name
+    size_t low = 0, high = mBlocks.size();
+    while (high - low > 1)
+    {
+        size_t middle = (low + high) / 2;
+        if (compareHead(middle, name) <= 0)
+            low = middle;
+        else
+            high = middle;
+    }
+
+    string candidate;
+    size_t pos = mBlocks[low];
+    size_t end = std::min(mCount, (low + 1) * kBlockSize);
+    for (size_t i = low * kBlockSize; i < end; ++i)
+    {
+        pos = decode(pos, candidate);
+        int cmp = candidate.compare(name);
+        if (cmp == 0)
+        {
+            index = i;
+            return true;
+        }
+        if (cmp > 0)
+            break;
+    }
+    return false;
+}
+
+void NameStore::Swap(NameStore& other)
+{
+    mData.swap(other.mData);
+    mBlocks.swap(other.mBlocks);
+    std::swap(mCount, other.mCount);
+    mLast.swap(other.mLast);
+}
+
+bool NameStore::Cursor::Next(string& name)
+{
+    if (mIndex == mStore.mCount)
+        return false;
+    mPos = mStore.decode(mPos, name);
+    ++mIndex;
+    return true;
+}
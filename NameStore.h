@@ -0,0 +1,66 @@
+// NameStore.h
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// A sorted list of class names, front-coded: names in a tree share long
+// package prefixes, so each is stored as the length of the prefix it shares
+// with the name before it and the bytes that follow. Every kBlockSize-th name
+// starts a block and is stored whole, so a name is found by index or by value
+// decoding at most one block.
+class NameStore
+{
+public:
+    static const size_t kBlockSize = 16;
+
+    NameStore();
+
+    void Append(const string& name);
+    // name must sort after Last().
+
+    size_t Size() const { return mCount; }
+
+    const string& Last() const { return mLast; }
+
+    string Get(size_t index) const;
+
+    bool Find(const string& name, size_t& index) const;
+
+    size_t Bytes() const { return mData.size() + mBlocks.size() * sizeof(mBlocks[0]); }
+
+    void Swap(NameStore& other);
+
+    // Decodes the names in order, which is cheaper than Get for each
+    class Cursor
+    {
+    public:
+        explicit Cursor(const NameStore& store) : mStore(store), mIndex(0), mPos(0) {}
+
+        bool Next(string& name);
+        // Replaces name with the next name, or returns false after the last.
+        // name must hold the previous one, as Next left it.
+
+    private:
+        const NameStore& mStore;
+        size_t           mIndex;
+        size_t           mPos;
+    };
+
+private:
+    size_t decode(size_t pos, string& name) const;
+    int compareHead(size_t block, const string& name) const;
+
+private:
+    vector<uint8_t>  mData;
+    vector<uint64_t> mBlocks;   // offset in mData of each block's first name
+    size_t           mCount;
+    string           mLast;
+};
@@ -0,0 +1,78 @@
+// PackageGraph.cpp
+
+#include "PackageGraph.h"
+
+#include <inttypes.h>
+
+PackageGraph::PackageGraph(int depth)
+    : mDepth(depth)
+{
+}
+
+string PackageGraph::PackageOf(const string& packageAndName) const
+{
+    size_t end = packageAndName.rfind('/');
+    if (end == string::npos)
+        return ".";
+    if (mDepth > 0)
+    {
+        size_t slash = packageAndName.find('/');
+        for (int level = 1; level < mDepth && slash < end; ++level)
+            slash = packageAndName.find('/', slash + 1);
+        end = slash;
+    }
+    return packageAndName.substr(0, end);
+}
+
+void PackageGraph::AddClass(const string& name, const set<string>& deps, uint64_t)
+{
+    string package = PackageOf(name);
+    Edges& edges = mPackages[package];
+    for (set<string>::const_iterator it = deps.begin(); it != deps.end(); ++it)
+    {
+        string dep = PackageOf(*it);
+        if (dep != package)
+            ++edges[dep];
+    }
+}
+
+void PackageGraph::AddGraph(const DependencyGraph& graph)
+{
+    set<string> deps;
+    for (DependencyGraph::NodeId node = 0; node < graph.NodeCount(); ++node)
+    {
+        if (!graph.IsAnalyzed(node))
+            continue;
+        deps.clear();
+        const vector<DependencyGraph::NodeId>& edges = graph.Deps(node);
+        for (size_t i = 0; i < edges.size(); ++i)
+            deps.insert(graph.Name(edges[i]));
+        AddClass(graph.Name(node), deps);
+    }
+}
+
+void PackageGraph::WriteTabular(FILE* outFile) const
+{
+    for (map<string, Edges>::const_iterator it = mPackages.begin(); it != mPackages.end(); ++it)
+    {
+        const Edges& edges = it->second;
+        for (Edges::const_iterator dep = edges.begin(); dep != edges.end(); ++dep)
+            fprintf(outFile, "%s\t%s\t%" PRIu64 "\n",
+                    it->first.c_str(), dep->first.c_str(), dep->second);
+    }
+}
+
+void PackageGraph::WriteMakefile(FILE* outFile) const
+{
+    for (map<string, Edges>::const_iterator it = mPackages.begin(); it != mPackages.end(); ++it)
+    {
+        const Edges& edges = it->second;
+        for (Edges::const_iterator dep = edges.begin(); dep != edges.end(); ++dep)
+            fprintf(outFile, "# %s -> %s: %" PRIu64 "\n",
+                    it->first.c_str(), dep->first.c_str(), dep->second);
+        fprintf(outFile, "%s: \\\n", it->first.c_str());
+        for (Edges::const_iterator dep = edges.begin(); dep != edges.end(); ++dep)
+            fprintf(outFile, "  %s \\\n", dep->first.c_str());
+        fprintf(outFile, "\n");
+    }
+}
@@ -0,0 +1,49 @@
+// PackageGraph.h
+
+#pragma once
+
+#include "DependencyGraph.h"
+#include "GraphSink.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+#include <string>
+
+using std::map;
+using std::string;
+
+// The class dependency graph rolled up to packages, for builds whose unit is
+// a package or module rather than a class: an edge from each package to each
+// package its classes depend on, weighted by the number of class-level edges
+// it stands for. Edges within a package are dropped.
+class PackageGraph : public GraphSink
+{
+public:
+    explicit PackageGraph(int depth);
+    // Rolls each class up to the first depth components of its package, or
+    // to its whole package if depth is 0 or the package is shallower.
+
+    void AddClass(const string& name, const set<string>& deps, uint64_t size = 0);
+
+    void AddGraph(const DependencyGraph& graph);
+    // Adds every analyzed class of graph.
+
+    string PackageOf(const string& packageAndName) const;
+    // In path form, without the trailing slash. Classes in the default
+    // package roll up to ".".
+
+    void WriteTabular(FILE* outFile) const;
+    // One "package<TAB>dependency<TAB>weight" line per edge.
+
+    void WriteMakefile(FILE* outFile) const;
+    // A make rule per package naming the packages it depends on, preceded
+    // by a "# package -> dependency: weight" comment for each.
+
+private:
+    typedef map<string, uint64_t> Edges;
+
+    int                 mDepth;
+    map<string, Edges>  mPackages;      // every package with an analyzed class
+};
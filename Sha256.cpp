@@ -0,0 +1,128 @@
+// Sha256.cpp
+
+#include "Sha256.h"
+
+#include <algorithm>
+
+static const uint32_t kRoundConstants[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotate(uint32_t value, int bits)
+{
+    return (value >> bits) | (value << (32 - bits));
+}
+
+string Sha256::Digest::Hex() const
+{
+    static const char kDigits[] = "0123456789abcdef";
+    string hex;
+    for (size_t i = 0; i < sizeof(bytes); ++i)
+    {
+        hex += kDigits[bytes[i] >> 4];
+        hex += kDigits[bytes[i] & 15];
+    }
+    return hex;
+}
+
+Sha256::Sha256()
+    : mBuffered(0)
+    , mLength(0)
+{
+    static const uint32_t kInitialState[8] =
+    {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(mState, kInitialState, sizeof(mState));
+}
+
+void Sha256::block(const uint8_t* data)
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i)
+        w[i] = (uint32_t) data[4*i] << 24 | (uint32_t) data[4*i+1] << 16 | (uint32_t) data[4*i+2] << 8 | data[4*i+3];
+    for (int i = 16; i < 64; ++i)
+    {
+        uint32_t s0 = rotate(w[i-15], 7) ^ rotate(w[i-15], 18) ^ (w[i-15] >> 3);
+        uint32_t s1 = rotate(w[i-2], 17) ^ rotate(w[i-2], 19) ^ (w[i-2] >> 10);
+        w[i] = w[i-16] + s0 + w[i-7] + s1;
+    }
+
+    uint32_t a = mState[0], b = mState[1], c = mState[2], d = mState[3];
+    uint32_t e = mState[4], f = mState[5], g = mState[6], h = mState[7];
+    for (int i = 0; i < 64; ++i)
+    {
+        uint32_t t1 = h + (rotate(e, 6) ^ rotate(e, 11) ^ rotate(e, 25)) + ((e & f) ^ (~e & g))
+                    + kRoundConstants[i] + w[i];
+        uint32_t t2 = (rotate(a, 2) ^ rotate(a, 13) ^ rotate(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    mState[0] += a; mState[1] += b; mState[2] += c; mState[3] += d;
+    mState[4] += e; mState[5] += f; mState[6] += g; mState[7] += h;
+}
+
+void Sha256::Update(const void* data, size_t length)
+{
+    const uint8_t* bytes = (const uint8_t*) data;
+    mLength += length;
+    while (length > 0)
+    {
+        if (mBuffered == 0 && length >= 64)
+        {
+            block(bytes);
+            bytes += 64;
+            length -= 64;
+            continue;
+        }
+        size_t take = std::min(length, 64 - mBuffered);
+        memcpy(mBuffer + mBuffered, bytes, take);
+        mBuffered += take;
+        bytes += take;
+        length -= take;
+        if (mBuffered == 64)
+        {
+            block(mBuffer);
+            mBuffered = 0;
+        }
+    }
+}
+
+Sha256::Digest Sha256::Finish()
+{
+    uint64_t bits = mLength * 8;
+    uint8_t pad = 0x80;
+    Update(&pad, 1);
+    pad = 0;
+    while (mBuffered != 56)
+        Update(&pad, 1);
+    uint8_t length[8];
+    for (int i = 0; i < 8; ++i)
+        length[i] = bits >> (56 - 8 * i);
+    Update(length, 8);
+
+    Digest digest;
+    for (int i = 0; i < 8; ++i)
+    {
+        digest.bytes[4*i] = mState[i] >> 24;
+        digest.bytes[4*i+1] = mState[i] >> 16;
+        digest.bytes[4*i+2] = mState[i] >> 8;
+        digest.bytes[4*i+3] = mState[i];
+    }
+    return digest;
+}
+
+Sha256::Digest Sha256::Of(const void* data, size_t length)
+{
+    Sha256 hash;
+    hash.Update(data, length);
+    return hash.Finish();
+}
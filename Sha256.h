@@ -0,0 +1,45 @@
+// Sha256.h
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+
+using std::string;
+
+// FIPS 180-4 SHA-256, so that content hashes need no crypto library
+class Sha256
+{
+public:
+    struct Digest
+    {
+        uint8_t bytes[32];
+
+        bool operator<(const Digest& other) const { return memcmp(bytes, other.bytes, 32) < 0; }
+        bool operator==(const Digest& other) const { return memcmp(bytes, other.bytes, 32) == 0; }
+
+        string Hex() const;
+    };
+
+    Sha256();
+
+    void Update(const void* data, size_t length);
+    void Update(const string& text) { Update(text.data(), text.size()); }
+    void Update(const Digest& digest) { Update(digest.bytes, sizeof(digest.bytes)); }
+
+    Digest Finish();
+    // The digest of everything passed to Update. Call once.
+
+    static Digest Of(const void* data, size_t length);
+
+private:
+    void block(const uint8_t* data);
+
+private:
+    uint32_t mState[8];
+    uint8_t  mBuffer[64];
+    size_t   mBuffered;   // bytes of mBuffer in use
+    uint64_t mLength;     // total bytes hashed
+};
@@ -0,0 +1,75 @@
+// SpillFile.cpp
+
+#include "SpillFile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+SpillFile::SpillFile()
+    : mFile(0)
+    , mData(0)
+    , mLength(0)
+{
+}
+
+SpillFile::~SpillFile()
+{
+    if (mData)
+        munmap(mData, mLength);
+    if (mFile)
+        fclose(mFile);
+}
+
+bool SpillFile::Create(const string& dir)
+{
+    string pattern = dir;
+    if (pattern.empty() || pattern[pattern.size()-1] != '/')
+        pattern += '/';
+    pattern += "jdep-spill-XXXXXX";
+
+    int fd = mkstemp(&pattern[0]);
+    if (fd < 0)
+    {
+        mError = "unable to create spill file in " + dir + ": " + strerror(errno);
+        return false;
+    }
+    unlink(pattern.c_str());
+    mFile = fdopen(fd, "w+b");
+    if (!mFile)
+    {
+        close(fd);
+        mError = "unable to open spill file in " + dir;
+        return false;
+    }
+    return true;
+}
+
+bool SpillFile::Map(size_t bytes)
+{
+    int fd = fileno(mFile);
+    off_t size = lseek(fd, 0, SEEK_END);
+    // Reserve the blocks now: a sparse file on a full disk would map fine,
+    // then kill the process with SIGBUS at the first page written.
+    int error = size < (off_t) bytes ? posix_fallocate(fd, size, bytes - size) : 0;
+    if (error != 0)
+    {
+        mError = string("unable to grow spill file: ") + strerror(error);
+        return false;
+    }
+    if ((off_t) bytes < size)
+        bytes = size;
+
+    void* data = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        mError = string("unable to map spill file: ") + strerror(errno);
+        return false;
+    }
+    mData = data;
+    mLength = bytes;
+    return true;
+}
@@ -0,0 +1,71 @@
+// SpillFile.h
+
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <string>
+
+using std::string;
+
+// An anonymous scratch file in a spill directory. It is unlinked as soon as it
+// is created, so it vanishes with the process however that ends. It can be
+// used as a stream, or mapped into memory so that large arrays live in the
+// page cache, where the kernel can write them back, rather than on the heap.
+class SpillFile
+{
+public:
+    SpillFile();
+    ~SpillFile();
+
+    bool Create(const string& dir);
+    // Returns false, leaving the reason in Error(), on failure.
+
+    FILE* Stream() { return mFile; }
+
+    bool Map(size_t bytes);
+    // Grows the file to at least bytes and maps it read-write. Anything
+    // written through Stream() must be flushed first.
+
+    void* Data() const { return mData; }
+    size_t Length() const { return mLength; }
+
+    const string& Error() const { return mError; }
+
+private:
+    SpillFile(const SpillFile&);
+    void operator=(const SpillFile&);
+
+private:
+    FILE*  mFile;
+    void*  mData;
+    size_t mLength;
+    string mError;
+};
+
+// A fixed-size array of T kept in a SpillFile.
+template <typename T>
+class MappedArray
+{
+public:
+    MappedArray() : mCount(0) {}
+
+    bool Allocate(const string& dir, size_t count)
+    {
+        mCount = count;
+        // Mapping zero bytes fails, and a new file reads as zeros anyway
+        return mFile.Create(dir) && mFile.Map((count ? count : 1) * sizeof(T));
+    }
+
+    T& operator[](size_t index) { return ((T*) mFile.Data())[index]; }
+    const T& operator[](size_t index) const { return ((const T*) mFile.Data())[index]; }
+
+    size_t Size() const { return mCount; }
+
+    const string& Error() const { return mFile.Error(); }
+
+private:
+    SpillFile mFile;
+    size_t    mCount;
+};
@@ -0,0 +1,113 @@
+// TraceLog.cpp
+
+#include "TraceLog.h"
+
+#include <inttypes.h>
+#include <unistd.h>
+
+static const char* const kSpanNames[] = { "open", "read", "parse", "findDeps", "write" };
+
+TraceBuffer::TraceBuffer(std::chrono::steady_clock::time_point start, uint32_t thread)
+    : mStart(start)
+    , mThread(thread)
+{
+}
+
+static uint64_t nanosecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+void TraceBuffer::Begin(Span span, const string& file)
+{
+    Event event;
+    event.time = nanosecondsSince(mStart);
+    event.value = mFiles.size();
+    event.span = span;
+    event.begin = true;
+    mFiles.append(file.c_str(), file.size() + 1);
+    mEvents.push_back(event);
+}
+
+void TraceBuffer::End(Span span, uint64_t size)
+{
+    Event event;
+    event.time = nanosecondsSince(mStart);
+    event.value = size;
+    event.span = span;
+    event.begin = false;
+    mEvents.push_back(event);
+}
+
+TraceLog::TraceLog()
+    : mStart(std::chrono::steady_clock::now())
+{
+}
+
+TraceLog::~TraceLog()
+{
+    for (size_t i = 0; i < mBuffers.size(); ++i)
+        delete mBuffers[i];
+}
+
+TraceBuffer* TraceLog::NewBuffer()
+{
+    std::lock_guard<std::mutex> hold(mLock);
+    mBuffers.push_back(new TraceBuffer(mStart, mBuffers.size()));
+    return mBuffers.back();
+}
+
+static void writeJsonString(FILE* outFile, const char* text)
+{
+    fputc('"', outFile);
+    for (; *text; ++text)
+    {
+        unsigned char c = *text;
+        if (c == '"' || c == '\\')
+            fprintf(outFile, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(outFile, "\\u%04x", c);
+        else
+            fputc(c, outFile);
+    }
+    fputc('"', outFile);
+}
+
+void TraceLog::Write(FILE* outFile) const
+{
+    std::lock_guard<std::mutex> hold(mLock);
+    int pid = getpid();
+    const char* separator = "";
+    fprintf(outFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (size_t b = 0; b < mBuffers.size(); ++b)
+    {
+        const TraceBuffer& buffer = *mBuffers[b];
+        fprintf(outFile, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,"
+                "\"args\":{\"name\":", separator, pid, buffer.mThread);
+        if (buffer.mThread == 0)
+            fprintf(outFile, "\"main\"}}");
+        else
+            fprintf(outFile, "\"worker %u\"}}", buffer.mThread);
+        separator = ",";
+
+        // Timestamps are in microseconds; keep the nanoseconds as decimals
+        for (size_t i = 0; i < buffer.mEvents.size(); ++i)
+        {
+            const TraceBuffer::Event& event = buffer.mEvents[i];
+            fprintf(outFile, ",\n{\"name\":\"%s\",\"cat\":\"jdep\",\"ph\":\"%c\",\"pid\":%d,"
+                    "\"tid\":%u,\"ts\":%" PRIu64 ".%03u,\"args\":{",
+                    kSpanNames[event.span], event.begin ? 'B' : 'E', pid, buffer.mThread,
+                    event.time / 1000, (unsigned) (event.time % 1000));
+            if (event.begin)
+            {
+                fprintf(outFile, "\"file\":");
+                writeJsonString(outFile, buffer.mFiles.c_str() + event.value);
+            }
+            else
+                fprintf(outFile, "\"size\":%" PRIu64, event.value);
+            fprintf(outFile, "}}");
+        }
+    }
+    fprintf(outFile, "\n]}\n");
+}
@@ -0,0 +1,111 @@
+// TraceLog.h
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+class TraceLog;
+
+// The events one thread records. Only that thread appends to it, so
+// recording takes no lock: an event is a clock read and a few words, and a
+// file name is copied into one growing string rather than allocated.
+class TraceBuffer
+{
+public:
+    enum Span
+    {
+        kOpen,          // finding the class file and opening it
+        kRead,          // reading it into memory
+        kParse,         // decoding its constant pool, fields and methods
+        kFindDeps,      // the whole of a class, inner classes nested inside
+        kWrite          // formatting and writing a class's output
+    };
+
+    void Begin(Span span, const string& file);
+    void End(Span span, uint64_t size);
+    // size is the bytes the span handled, or 0 if it has none.
+
+private:
+    friend class TraceLog;
+
+    TraceBuffer(std::chrono::steady_clock::time_point start, uint32_t thread);
+
+    struct Event
+    {
+        uint64_t time;      // nanoseconds since the log started
+        uint64_t value;     // offset of the file name in mFiles, or the size
+        uint8_t  span;
+        bool     begin;
+    };
+
+    std::chrono::steady_clock::time_point mStart;
+    uint32_t      mThread;
+    vector<Event> mEvents;
+    string        mFiles;   // each Begin's file name, NUL terminated
+};
+
+// Records when each file's open, read, parse, dependency walk and output
+// write begin and end, on every thread, to show which files or threads
+// stall a run. Each thread records into its own TraceBuffer; Write exports
+// them all as Chrome trace-event JSON, for chrome://tracing or Perfetto.
+class TraceLog
+{
+public:
+    TraceLog();
+    ~TraceLog();
+
+    TraceBuffer* NewBuffer();
+    // A buffer for the calling thread, which must be the only one to record
+    // into it. Threads are numbered in the order they ask, the first being
+    // the main thread. The buffer lives as long as the log. Safe to call
+    // from any thread.
+
+    void Write(FILE* outFile) const;
+    // Call once every thread has stopped recording.
+
+private:
+    std::chrono::steady_clock::time_point mStart;
+    vector<TraceBuffer*> mBuffers;
+    mutable std::mutex   mLock;
+};
+
+// Records span over its own lifetime, so that every way out of a function
+// ends it, unless ended earlier. Does nothing without a buffer.
+class TraceSpan
+{
+public:
+    TraceSpan(TraceBuffer* buffer, TraceBuffer::Span span, const string& file)
+        : mBuffer(buffer)
+        , mSpan(span)
+        , mSize(0)
+    {
+        if (mBuffer)
+            mBuffer->Begin(span, file);
+    }
+
+    ~TraceSpan() { End(); }
+
+    void SetSize(uint64_t size) { mSize = size; }
+
+    void End()
+    {
+        if (mBuffer)
+            mBuffer->End(mSpan, mSize);
+        mBuffer = 0;
+    }
+    // Ends the span early, before what follows in the same scope.
+
+private:
+    TraceBuffer*      mBuffer;
+    TraceBuffer::Span mSpan;
+    uint64_t          mSize;
+};
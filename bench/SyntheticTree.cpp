@@ -0,0 +1,522 @@
+// SyntheticTree.cpp
+
+#include "SyntheticTree.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+using std::unordered_map;
+
+const char* const kRoot = "com/synth";
+const char* const kAnnotationPackage = "com/synth/annotation";
+
+const char* const kSegments[] =
+{
+    "core", "api", "impl", "util", "model", "service", "web", "data",
+    "io", "net", "config", "internal", "spi", "event", "cache", "security"
+};
+const size_t kSegmentCount = sizeof(kSegments) / sizeof(kSegments[0]);
+
+const char* const kStems[] =
+{
+    "Order", "Account", "Node", "Widget", "Session", "Request", "Index",
+    "Report", "Graph", "Cache", "Token", "Shape", "Query", "Ledger"
+};
+const size_t kStemCount = sizeof(kStems) / sizeof(kStems[0]);
+
+const char* const kSuffixes[] =
+{
+    "", "Service", "Impl", "Factory", "Handler", "Util", "Manager", "Builder"
+};
+const size_t kSuffixCount = sizeof(kSuffixes) / sizeof(kSuffixes[0]);
+
+// Library classes every class names, which jdep excludes by default
+const char* const kLibraryClasses[] =
+{
+    "java/lang/Object", "java/lang/String", "java/util/List", "java/util/Map"
+};
+const size_t kLibraryClassCount = sizeof(kLibraryClasses) / sizeof(kLibraryClasses[0]);
+
+const size_t kNoDep = (size_t) -1;
+
+// Bumped whenever the same shape starts giving a different tree, so that
+// trees already on disk are regenerated
+const int kGeneratorVersion = 2;
+
+TreeShape::TreeShape()
+    : classes(10000)
+    , packageDepth(4)
+    , classesPerPackage(25)
+    , innerRatio(0.4)
+    , annotationDensity(0.3)
+    , depsPerClass(8)
+    , cycleRate(0.03)
+    , seed(1)
+{
+}
+
+string TreeShape::Describe() const
+{
+    char line[256];
+    snprintf(line, sizeof(line),
+             "classes=%zu depth=%g per-package=%zu inner=%g annotations=%g deps=%g cycles=%g seed=%u"
+             " generator=%d",
+             classes, packageDepth, classesPerPackage, innerRatio, annotationDensity,
+             depsPerClass, cycleRate, seed, kGeneratorVersion);
+    return line;
+}
+
+// splitmix64, so that a seed gives the same tree on every platform
+struct SyntheticTree::Random
+{
+    uint64_t state;
+
+    Random(uint64_t seed) : state(seed) {}
+
+    uint64_t Next()
+    {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    size_t Below(size_t count) { return count ? Next() % count : 0; }
+
+    double Unit() { return (Next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    size_t Geometric(double mean)
+    {
+        // Failures before the first success at p = 1 / (1 + mean), whose
+        // mean is mean; flooring a continuous draw would fall well short
+        if (mean <= 0)
+            return 0;
+        return (size_t) floor(log(1.0 - Unit()) / log(mean / (1.0 + mean)));
+    }
+};
+
+// Builds one class file, constant pool entries shared as javac shares them
+class ClassWriter
+{
+public:
+    ClassWriter()
+        : mCount(1)
+        , mFieldCount(0)
+        , mMethodCount(0)
+        , mAttributeCount(0)
+    {}
+
+    uint16_t Utf8(const string& text)
+    {
+        uint16_t& index = mIndex["u" + text];
+        if (!index)
+        {
+            index = mCount++;
+            mPool.push_back(1);
+            put16(mPool, text.size());
+            mPool.insert(mPool.end(), text.begin(), text.end());
+        }
+        return index;
+    }
+
+    uint16_t Class(const string& name)
+    {
+        uint16_t nameIndex = Utf8(name);
+        uint16_t& index = mIndex["c" + name];
+        if (!index)
+        {
+            index = mCount++;
+            mPool.push_back(7);
+            put16(mPool, nameIndex);
+        }
+        return index;
+    }
+
+    uint16_t Methodref(const string& owner, const string& name, const string& descriptor)
+    {
+        uint16_t ownerIndex = Class(owner);
+        uint16_t nameIndex = Utf8(name);
+        uint16_t descriptorIndex = Utf8(descriptor);
+        uint16_t nameAndType = mCount++;
+        mPool.push_back(12);
+        put16(mPool, nameIndex);
+        put16(mPool, descriptorIndex);
+        uint16_t index = mCount++;
+        mPool.push_back(10);
+        put16(mPool, ownerIndex);
+        put16(mPool, nameAndType);
+        return index;
+    }
+
+    vector<uint8_t> Annotation(const string& type, const string& enumType)
+    {
+        // @type(value = enumType.DEFAULT)
+        vector<uint8_t> bytes;
+        put16(bytes, Utf8("L" + type + ";"));
+        put16(bytes, 1);
+        put16(bytes, Utf8("value"));
+        bytes.push_back('e');
+        put16(bytes, Utf8("L" + enumType + ";"));
+        put16(bytes, Utf8("DEFAULT"));
+        return bytes;
+    }
+
+    void AddField(const string& name, const string& descriptor)
+    {
+        put16(mFields, 0x0002);
+        put16(mFields, Utf8(name));
+        put16(mFields, Utf8(descriptor));
+        put16(mFields, 0);
+        ++mFieldCount;
+    }
+
+    void AddMethod(const string& name, const string& descriptor, size_t codeLength,
+                   const vector<uint8_t>& annotation)
+    {
+        put16(mMethods, 0x0001);
+        put16(mMethods, Utf8(name));
+        put16(mMethods, Utf8(descriptor));
+        put16(mMethods, annotation.empty() ? 1 : 2);
+        vector<uint8_t> code;
+        put16(code, 2);           // max_stack
+        put16(code, 1);           // max_locals
+        put32(code, codeLength);
+        code.insert(code.end(), codeLength - 1, 0x00);   // nop...
+        code.push_back(0xb1);     // return
+        put16(code, 0);           // exception_table_length
+        put16(code, 0);           // attributes_count
+        putAttribute(mMethods, "Code", code);
+        if (!annotation.empty())
+            putAttribute(mMethods, "RuntimeVisibleAnnotations", annotations(annotation));
+        ++mMethodCount;
+    }
+
+    void AddAttribute(const string& name, const vector<uint8_t>& info)
+    {
+        putAttribute(mAttributes, name, info);
+        ++mAttributeCount;
+    }
+
+    void AddAnnotation(const vector<uint8_t>& annotation)
+    {
+        AddAttribute("RuntimeVisibleAnnotations", annotations(annotation));
+    }
+
+    vector<uint8_t> Finish(uint16_t access, const string& name, const string& super,
+                           const string& interface)
+    {
+        uint16_t thisIndex = Class(name);
+        uint16_t superIndex = Class(super);
+        uint16_t interfaceIndex = interface.empty() ? 0 : Class(interface);
+
+        vector<uint8_t> bytes;
+        put32(bytes, 0xCAFEBABE);
+        put16(bytes, 0);
+        put16(bytes, 52);
+        put16(bytes, mCount);
+        bytes.insert(bytes.end(), mPool.begin(), mPool.end());
+        put16(bytes, access);
+        put16(bytes, thisIndex);
+        put16(bytes, superIndex);
+        put16(bytes, interfaceIndex ? 1 : 0);
+        if (interfaceIndex)
+            put16(bytes, interfaceIndex);
+        put16(bytes, mFieldCount);
+        bytes.insert(bytes.end(), mFields.begin(), mFields.end());
+        put16(bytes, mMethodCount);
+        bytes.insert(bytes.end(), mMethods.begin(), mMethods.end());
+        put16(bytes, mAttributeCount);
+        bytes.insert(bytes.end(), mAttributes.begin(), mAttributes.end());
+        return bytes;
+    }
+
+    static void put16(vector<uint8_t>& bytes, uint32_t value)
+    {
+        bytes.push_back(value >> 8);
+        bytes.push_back(value);
+    }
+
+    static void put32(vector<uint8_t>& bytes, uint32_t value)
+    {
+        put16(bytes, value >> 16);
+        put16(bytes, value);
+    }
+
+private:
+    vector<uint8_t> annotations(const vector<uint8_t>& annotation)
+    {
+        vector<uint8_t> info;
+        put16(info, 1);
+        info.insert(info.end(), annotation.begin(), annotation.end());
+        return info;
+    }
+
+    void putAttribute(vector<uint8_t>& bytes, const string& name, const vector<uint8_t>& info)
+    {
+        put16(bytes, Utf8(name));
+        put32(bytes, info.size());
+        bytes.insert(bytes.end(), info.begin(), info.end());
+    }
+
+private:
+    unordered_map<string, uint16_t> mIndex;
+    vector<uint8_t> mPool;
+    uint16_t        mCount;
+    vector<uint8_t> mFields;
+    vector<uint8_t> mMethods;
+    vector<uint8_t> mAttributes;
+    uint16_t        mFieldCount;
+    uint16_t        mMethodCount;
+    uint16_t        mAttributeCount;
+};
+
+static string innerName(const string& outer, size_t inner)
+{
+    // Alternate named and anonymous inner classes, as javac names them
+    char suffix[32];
+    if (inner % 2)
+        snprintf(suffix, sizeof(suffix), "$%zu", inner / 2 + 1);
+    else
+        snprintf(suffix, sizeof(suffix), "$Part%zu", inner / 2);
+    return outer + suffix;
+}
+
+SyntheticTree::SyntheticTree(const TreeShape& shape)
+    : mShape(shape)
+    , mFiles(0)
+    , mBytes(0)
+{
+    layOut();
+}
+
+void SyntheticTree::layOut()
+{
+    Random random(mShape.seed);
+    size_t classes = std::max(mShape.classes, (size_t) 2);
+    size_t perPackage = std::max(mShape.classesPerPackage, (size_t) 1);
+
+    // Package 0 holds the annotation types, which are also the enums their
+    // values name; the rest are ordinary, lowest layer first.
+    size_t annotations = std::min(std::max(classes / 20, (size_t) 1), (size_t) 16);
+    mPackages.push_back(kAnnotationPackage);
+    mPackageFirst.push_back(0);
+    for (size_t first = annotations; first < classes; first += perPackage)
+    {
+        size_t package = mPackages.size();
+        long depth = lround(mShape.packageDepth + 2 * random.Unit() - 1);
+        string path = kRoot;
+        for (long level = 1; level < depth; ++level)
+            path += string("/") + kSegments[(package / (level * 3) + level) % kSegmentCount];
+        char last[64];
+        snprintf(last, sizeof(last), "/%s%zu", kSegments[package % kSegmentCount], package);
+        mPackages.push_back(path + last);
+        mPackageFirst.push_back(first);
+    }
+    mPackageFirst.push_back(classes);
+
+    for (size_t package = 0; package < mPackages.size(); ++package)
+    {
+        for (size_t index = mPackageFirst[package]; index < mPackageFirst[package + 1]; ++index)
+        {
+            char name[64];
+            if (package == 0)
+                snprintf(name, sizeof(name), "/Marker%zu", index);
+            else
+                snprintf(name, sizeof(name), "/%s%s%zu", kStems[random.Below(kStemCount)],
+                         kSuffixes[random.Below(kSuffixCount)], index);
+            mNames.push_back(mPackages[package] + name);
+            mPackageOf.push_back(package);
+            mInners.push_back(package == 0 ? 0 : std::min(random.Geometric(mShape.innerRatio), (size_t) 20));
+        }
+    }
+}
+
+size_t SyntheticTree::pickDep(Random& random, size_t from) const
+{
+    // Most dependencies stay in the package or reach down a few layers; the
+    // rest go to hubs at the bottom, the lowest few the busiest. Some point
+    // the other way, which is what makes cycles.
+    size_t packages = mPackages.size();
+    size_t package = mPackageOf[from];
+    size_t first = mPackageFirst[package];
+    size_t end = mPackageFirst[package + 1];
+    size_t hubFirst = mPackageFirst[1];
+    size_t hubs = std::max((mNames.size() - hubFirst) / 100, (size_t) 1);
+    bool back = random.Unit() < mShape.cycleRate;
+    double choice = random.Unit();
+
+    size_t dep = kNoDep;
+    if (choice < 0.55)
+    {
+        if (back && from + 1 < end)
+            dep = from + 1 + random.Below(end - from - 1);
+        else if (!back && from > first)
+            dep = first + random.Below(from - first);
+    }
+    else if (choice < 0.85)
+    {
+        size_t distance = 1 + random.Geometric(3);
+        size_t other = back ? package + distance : package - distance;
+        if (back ? other < packages : distance < package)
+            dep = mPackageFirst[other] + random.Below(mPackageFirst[other + 1] - mPackageFirst[other]);
+    }
+    if (dep == kNoDep)
+    {
+        double u = random.Unit();
+        dep = hubFirst + std::min((size_t) (hubs * u * u * u), hubs - 1);
+    }
+    return dep == from || mPackageOf[dep] == 0 ? kNoDep : dep;
+}
+
+bool SyntheticTree::writeClass(const string& root, size_t index, Random& random)
+{
+    const string& name = mNames[index];
+    size_t annotations = mPackageFirst[1];
+
+    if (mPackageOf[index] == 0)
+    {
+        ClassWriter writer;
+        writer.AddMethod("value", "()L" + name + ";", 1, vector<uint8_t>());
+        return writeFile(root, name, writer.Finish(0x2601, name, "java/lang/Object",
+                                                   "java/lang/annotation/Annotation"));
+    }
+
+    size_t inners = mInners[index];
+    vector<ClassWriter> writers(inners + 1);
+    size_t depCount = random.Below((size_t) (2 * mShape.depsPerClass) + 1);
+    string super = kLibraryClasses[0];
+    for (size_t i = 0; i < depCount; ++i)
+    {
+        size_t dep = pickDep(random, index);
+        if (dep == kNoDep)
+            continue;
+
+        // Each dependency lands in the outer class or one of its inner ones,
+        // and is named as a class, a method owner or a field type.
+        ClassWriter& writer = writers[random.Unit() < 0.6 || !inners ? 0 : 1 + random.Below(inners)];
+        const string& depName = mNames[dep];
+        double use = random.Unit();
+        if (i == 0 && use < 0.3)
+            super = depName;
+        else if (use < 0.5)
+            writer.Methodref(depName, "get", "()L" + depName + ";");
+        else if (use < 0.8)
+            writer.AddField("field" + std::to_string(i), "L" + depName + ";");
+        else
+            writer.Class(depName);
+
+        // Sometimes name one of its inner classes, which is a dependency on
+        // its outer class
+        if (mInners[dep] && random.Unit() < 0.2)
+            writer.Class(innerName(depName, random.Below(mInners[dep])));
+    }
+
+    for (size_t w = 0; w <= inners; ++w)
+    {
+        ClassWriter& writer = writers[w];
+        string className = w ? innerName(name, w - 1) : name;
+        for (size_t i = 0; i < kLibraryClassCount; ++i)
+            writer.Class(kLibraryClasses[i]);
+
+        size_t methods = 1 + random.Below(6);
+        for (size_t m = 0; m < methods; ++m)
+        {
+            vector<uint8_t> annotation;
+            if (random.Unit() < mShape.annotationDensity / 4)
+                annotation = writer.Annotation(mNames[random.Below(annotations)],
+                                               mNames[random.Below(annotations)]);
+            writer.AddMethod("method" + std::to_string(m), "()V", 4 + random.Below(120), annotation);
+        }
+
+        if (w == 0)
+        {
+            if (random.Unit() < mShape.annotationDensity)
+                writer.AddAnnotation(writer.Annotation(mNames[random.Below(annotations)],
+                                                       mNames[random.Below(annotations)]));
+            vector<uint8_t> innerClasses;
+            ClassWriter::put16(innerClasses, inners);
+            for (size_t i = 0; i < inners; ++i)
+            {
+                string inner = innerName(name, i);
+                ClassWriter::put16(innerClasses, writer.Class(inner));
+                ClassWriter::put16(innerClasses, i % 2 ? 0 : writer.Class(name));
+                ClassWriter::put16(innerClasses, i % 2 ? 0 : writer.Utf8(inner.substr(inner.rfind('$') + 1)));
+                ClassWriter::put16(innerClasses, 0x0008);
+            }
+            if (inners)
+                writer.AddAttribute("InnerClasses", innerClasses);
+        }
+        else
+            writer.Class(name);
+
+        vector<uint8_t> source;
+        ClassWriter::put16(source, writer.Utf8(name.substr(name.rfind('/') + 1) + ".java"));
+        writer.AddAttribute("SourceFile", source);
+
+        if (!writeFile(root, className, writer.Finish(0x0021, className, w ? kLibraryClasses[0] : super, "")))
+            return false;
+    }
+    return true;
+}
+
+static bool makeDirectories(const string& path)
+{
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1))
+    {
+        string prefix = path.substr(0, slash);
+        if (mkdir(prefix.c_str(), 0777) < 0 && errno != EEXIST)
+            return false;
+        if (slash == string::npos)
+            return true;
+    }
+}
+
+bool SyntheticTree::writeFile(const string& root, const string& name, const vector<uint8_t>& bytes)
+{
+    string path = root + "/" + name + ".class";
+    FILE* outFile = fopen(path.c_str(), "wb");
+    if (!outFile)
+    {
+        mError = "unable to create " + path;
+        return false;
+    }
+    fwrite(&bytes[0], 1, bytes.size(), outFile);
+    if (fclose(outFile) != 0)
+    {
+        mError = "error writing " + path;
+        return false;
+    }
+    ++mFiles;
+    mBytes += bytes.size();
+    return true;
+}
+
+bool SyntheticTree::Write(const string& root)
+{
+    mFiles = 0;
+    mBytes = 0;
+    for (size_t package = 0; package < mPackages.size(); ++package)
+    {
+        string dir = root + "/" + mPackages[package];
+        if (!makeDirectories(dir))
+        {
+            mError = "unable to create " + dir + ": " + strerror(errno);
+            return false;
+        }
+    }
+
+    for (size_t index = 0; index < mNames.size(); ++index)
+    {
+        // Seeded per class, so a class is the same whatever else changes
+        Random random(mShape.seed * 0x100000001b3ULL + index);
+        if (!writeClass(root, index, random))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,71 @@
+// SyntheticTree.h
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// The knobs that shape a generated class tree
+struct TreeShape
+{
+    size_t   classes;            // top-level classes
+    double   packageDepth;       // mean package nesting below com/synth
+    size_t   classesPerPackage;
+    double   innerRatio;         // mean inner classes per top-level class
+    double   annotationDensity;  // fraction of classes that carry annotations
+    double   depsPerClass;       // mean other classes each class names
+    double   cycleRate;          // fraction of those that point against the layering
+    uint32_t seed;
+
+    TreeShape();
+
+    string Describe() const;
+    // One line naming every knob, and the generator's version, to tell
+    // whether a tree on disk matches.
+};
+
+// Writes a tree of class files with the statistical shape of a real project:
+// packages nested to varying depth, dependencies that mostly stay within a
+// package or reach down to lower layers and a few heavily used hubs, some
+// reaching back up to form cycles, inner and anonymous classes, and runtime
+// annotations with enum values. The same shape always gives the same tree.
+// Only what jdep reads is realistic; the method bodies are filler.
+class SyntheticTree
+{
+public:
+    SyntheticTree(const TreeShape& shape);
+
+    bool Write(const string& root);
+    // Writes the class files under root, creating it if need be. Returns
+    // false, leaving the reason in Error(), on failure.
+
+    size_t FileCount() const { return mFiles; }
+    uint64_t Bytes() const { return mBytes; }
+    // What the last Write wrote, inner classes included.
+
+    const string& Error() const { return mError; }
+
+private:
+    struct Random;
+
+    void layOut();
+    size_t pickDep(Random& random, size_t from) const;
+    bool writeClass(const string& root, size_t index, Random& random);
+    bool writeFile(const string& root, const string& name, const vector<uint8_t>& bytes);
+
+private:
+    TreeShape        mShape;
+    vector<string>   mPackages;        // package of each package index
+    vector<size_t>   mPackageFirst;    // first class of each package, plus an end marker
+    vector<uint32_t> mPackageOf;       // package of each class
+    vector<string>   mNames;           // each class, package included
+    vector<uint8_t>  mInners;          // inner classes of each class
+    size_t           mFiles;
+    uint64_t         mBytes;
+    string           mError;
+};
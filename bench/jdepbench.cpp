@@ -0,0 +1,487 @@
+/*
+  jdepbench.cpp -- end-to-end scaling benchmark for jdep
+
+  Generates a synthetic class tree of a given shape (or reuses one already
+  generated with the same shape) and times jdep over all of it, for each
+  combination of parallel process count, analysis threads per process, and
+  cold or warm page cache. Each result
+  line is tab-separated so runs can be compared release over release.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "SyntheticTree.h"
+
+// Most bytes of class file paths handed to one jdep process, well inside
+// the kernel's limit on exec arguments
+const size_t kMaxArgumentBytes = 512 << 10;
+
+struct Options
+{
+    TreeShape      shape;
+    string         jdep;        // the jdep to run
+    string         format;      // jdep -f FORMAT
+    vector<size_t> jobs;        // parallel jdep processes to try
+    vector<size_t> threads;     // jdep --jobs, analysis threads per process, to try
+    vector<string> caches;      // "cold" and/or "warm"
+    size_t         repeat;      // runs per configuration; the median is reported
+    bool           generate;    // only generate the tree
+
+    Options()
+        : format("d")
+        , repeat(3)
+        , generate(false)
+    {}
+};
+
+struct Result
+{
+    double   wall;         // seconds
+    double   cpu;          // seconds, user and system, all processes
+    long     peakRss;      // KB, the largest of any one process
+    uint64_t outputBytes;
+};
+
+void Usage()
+{
+    printf("usage: jdepbench [options] DIR\n");
+    printf("Generates a class tree in DIR/classes, unless one of the same shape is there,\n");
+    printf("and reports how jdep performs over it.\n");
+    printf("options:\n");
+    printf("--classes N        Top-level classes to generate (default 10000)\n");
+    printf("--depth D          Mean package depth (default 4)\n");
+    printf("--per-package N    Classes per package (default 25)\n");
+    printf("--inner R          Mean inner classes per class (default 0.4)\n");
+    printf("--annotations F    Fraction of classes with annotations (default 0.3)\n");
+    printf("--deps N           Mean dependencies per class (default 8)\n");
+    printf("--cycles F         Fraction of dependencies that form cycles (default 0.03)\n");
+    printf("--seed N           Random seed (default 1)\n");
+    printf("--jobs LIST        Comma separated parallel jdep process counts (default 1)\n");
+    printf("--threads LIST     Comma separated jdep --jobs thread counts per process (default 1,2,4)\n");
+    printf("--cache LIST       cold, warm or cold,warm (default cold,warm)\n");
+    printf("--repeat N         Runs per configuration, median reported (default 3)\n");
+    printf("--format FORMAT    jdep output format: d, tab or bin (default d)\n");
+    printf("--jdep PATH        jdep to run (default: the one beside jdepbench)\n");
+    printf("--generate         Only generate the tree, without running jdep\n");
+    exit(0);
+}
+
+void Fail(const string& message)
+{
+    fprintf(stderr, "%s\n", message.c_str());
+    exit(1);
+}
+
+vector<string> Split(const string& list)
+{
+    vector<string> items;
+    size_t start = 0;
+    while (start <= list.size())
+    {
+        size_t comma = list.find(',', start);
+        if (comma == string::npos)
+            comma = list.size();
+        if (comma > start)
+            items.push_back(list.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return items;
+}
+
+vector<size_t> Counts(const string& list, const string& what)
+{
+    vector<size_t> counts;
+    vector<string> items = Split(list);
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        size_t count = strtoul(items[i].c_str(), 0, 10);
+        if (count == 0)
+            Fail(what + " counts must be positive: " + list);
+        counts.push_back(count);
+    }
+    return counts;
+}
+
+enum
+{
+    kClassesOption = 256,
+    kDepthOption,
+    kPerPackageOption,
+    kInnerOption,
+    kAnnotationsOption,
+    kDepsOption,
+    kCyclesOption,
+    kSeedOption,
+    kJobsOption,
+    kThreadsOption,
+    kCacheOption,
+    kRepeatOption,
+    kFormatOption,
+    kJdepOption,
+    kGenerateOption
+};
+
+const struct option kLongOptions[] =
+{
+    { "classes",     required_argument, 0, kClassesOption },
+    { "depth",       required_argument, 0, kDepthOption },
+    { "per-package", required_argument, 0, kPerPackageOption },
+    { "inner",       required_argument, 0, kInnerOption },
+    { "annotations", required_argument, 0, kAnnotationsOption },
+    { "deps",        required_argument, 0, kDepsOption },
+    { "cycles",      required_argument, 0, kCyclesOption },
+    { "seed",        required_argument, 0, kSeedOption },
+    { "jobs",        required_argument, 0, kJobsOption },
+    { "threads",     required_argument, 0, kThreadsOption },
+    { "cache",       required_argument, 0, kCacheOption },
+    { "repeat",      required_argument, 0, kRepeatOption },
+    { "format",      required_argument, 0, kFormatOption },
+    { "jdep",        required_argument, 0, kJdepOption },
+    { "generate",    no_argument,       0, kGenerateOption },
+    { "help",        no_argument,       0, 'h' },
+    { 0, 0, 0, 0 }
+};
+
+void ParseArgs(int& argc, char**& argv, Options& options)
+{
+    string self = argv[0];
+    size_t slash = self.rfind('/');
+    options.jdep = (slash == string::npos ? string(".") : self.substr(0, slash)) + "/jdep";
+    string jobs = "1";
+    string threads = "1,2,4";
+    string caches = "cold,warm";
+
+    while (true)
+    {
+        int c = getopt_long(argc, argv, "h", kLongOptions, 0);
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+            case kClassesOption:     options.shape.classes = strtoul(optarg, 0, 10); break;
+            case kDepthOption:       options.shape.packageDepth = atof(optarg); break;
+            case kPerPackageOption:  options.shape.classesPerPackage = strtoul(optarg, 0, 10); break;
+            case kInnerOption:       options.shape.innerRatio = atof(optarg); break;
+            case kAnnotationsOption: options.shape.annotationDensity = atof(optarg); break;
+            case kDepsOption:        options.shape.depsPerClass = atof(optarg); break;
+            case kCyclesOption:      options.shape.cycleRate = atof(optarg); break;
+            case kSeedOption:        options.shape.seed = strtoul(optarg, 0, 10); break;
+            case kJobsOption:        jobs = optarg; break;
+            case kThreadsOption:     threads = optarg; break;
+            case kCacheOption:       caches = optarg; break;
+            case kRepeatOption:      options.repeat = strtoul(optarg, 0, 10); break;
+            case kFormatOption:      options.format = optarg; break;
+            case kJdepOption:        options.jdep = optarg; break;
+            case kGenerateOption:    options.generate = true; break;
+            default:                 Usage(); break;
+        }
+    }
+
+    options.jobs = Counts(jobs, "job");
+    options.threads = Counts(threads, "thread");
+    options.caches = Split(caches);
+    for (size_t i = 0; i < options.caches.size(); ++i)
+    {
+        if (options.caches[i] != "cold" && options.caches[i] != "warm")
+            Fail("cache must be cold or warm: " + caches);
+    }
+    if (options.shape.classes < 2 || options.repeat == 0 || options.jobs.empty()
+        || options.threads.empty())
+        Fail("need at least 2 classes, 1 repeat, 1 job count and 1 thread count");
+    if (options.format != "d" && options.format != "tab" && options.format != "bin")
+        Fail("format must be d, tab or bin");
+
+    argc -= optind;
+    argv += optind;
+    if (argc != 1)
+        Usage();
+}
+
+// nftw offers no context pointer, so its callbacks share these
+vector<string> gFiles;
+uint64_t gBytes;
+
+int collectFile(const char* path, const struct stat* info, int type, struct FTW*)
+{
+    if (type == FTW_F)
+    {
+        gFiles.push_back(path);
+        gBytes += info->st_size;
+    }
+    return 0;
+}
+
+int removeFile(const char* path, const struct stat*, int, struct FTW*)
+{
+    return remove(path) < 0 && errno != ENOENT ? -1 : 0;
+}
+
+vector<string> ListFiles(const string& dir, uint64_t* bytes = 0)
+{
+    gFiles.clear();
+    gBytes = 0;
+    nftw(dir.c_str(), collectFile, 64, FTW_PHYS);
+    if (bytes)
+        *bytes = gBytes;
+    std::sort(gFiles.begin(), gFiles.end());
+    return gFiles;
+}
+
+void RemoveTree(const string& dir)
+{
+    if (access(dir.c_str(), F_OK) == 0 && nftw(dir.c_str(), removeFile, 64, FTW_DEPTH | FTW_PHYS) != 0)
+        Fail("unable to remove " + dir);
+}
+
+string ReadLine(const string& path)
+{
+    char line[1000] = "";
+    FILE* inFile = fopen(path.c_str(), "r");
+    if (inFile)
+    {
+        if (!fgets(line, sizeof(line), inFile))
+            line[0] = '\0';
+        fclose(inFile);
+    }
+    string text = line;
+    if (!text.empty() && text[text.size()-1] == '\n')
+        text.resize(text.size() - 1);
+    return text;
+}
+
+void PrepareTree(const string& dir, const TreeShape& shape)
+{
+    string classes = dir + "/classes";
+    string shapeFile = dir + "/shape";
+    if (ReadLine(shapeFile) == shape.Describe())
+        return;
+
+    fprintf(stderr, "Generating %s\n", shape.Describe().c_str());
+    RemoveTree(classes);
+    remove(shapeFile.c_str());
+    mkdir(dir.c_str(), 0777);
+
+    SyntheticTree tree(shape);
+    if (!tree.Write(classes))
+        Fail(tree.Error());
+
+    // Recorded last, so an interrupted generation is redone
+    FILE* outFile = fopen(shapeFile.c_str(), "w");
+    if (!outFile)
+        Fail("unable to create " + shapeFile);
+    fprintf(outFile, "%s\n", shape.Describe().c_str());
+    fclose(outFile);
+}
+
+bool EvictCache(const vector<string>& files)
+{
+    // Dropping every cache needs root; otherwise ask for each file's pages
+    // to be dropped, which leaves the directory entries cached.
+    sync();
+    int fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+    if (fd >= 0)
+    {
+        bool dropped = write(fd, "3", 1) == 1;
+        close(fd);
+        if (dropped)
+            return true;
+    }
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        int fd = open(files[i].c_str(), O_RDONLY);
+        if (fd >= 0)
+        {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+    return false;
+}
+
+double Now()
+{
+    struct timeval now;
+    gettimeofday(&now, 0);
+    return now.tv_sec + now.tv_usec / 1e6;
+}
+
+double Seconds(const struct timeval& time)
+{
+    return time.tv_sec + time.tv_usec / 1e6;
+}
+
+pid_t Spawn(const vector<string>& args, const string& logPath)
+{
+    pid_t pid = fork();
+    if (pid != 0)
+        return pid;
+
+    // jdep reports every class it analyzes on stderr; keep that out of the way
+    int log = open(logPath.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0666);
+    if (log >= 0)
+        dup2(log, 2);
+    // Under make -j, jdep would share make's job slots and run fewer threads
+    // than asked
+    unsetenv("MAKEFLAGS");
+    vector<char*> argv;
+    for (size_t i = 0; i < args.size(); ++i)
+        argv.push_back((char*) args[i].c_str());
+    argv.push_back(0);
+    execv(argv[0], &argv[0]);
+    _exit(127);
+}
+
+Result RunJdep(const Options& options, const string& dir, const vector<string>& classes,
+              size_t jobs, size_t threads)
+{
+    string outDir = dir + "/out";
+    string logPath = dir + "/jdep.log";
+    RemoveTree(outDir);
+    mkdir(outDir.c_str(), 0777);
+    remove(logPath.c_str());
+
+    // Split the classes into chunks, at least one per job, like xargs -P
+    size_t perChunk = (classes.size() + jobs - 1) / jobs;
+    vector<vector<string> > chunks;
+    for (size_t i = 0; i < classes.size(); )
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "/chunk%zu.%s", chunks.size(), options.format.c_str());
+        vector<string> args;
+        args.push_back(options.jdep);
+        args.push_back("-c");
+        args.push_back(dir + "/classes");
+        args.push_back("-f");
+        args.push_back(options.format);
+        args.push_back("--jobs");
+        args.push_back(std::to_string(threads));
+        if (options.format == "d")
+        {
+            args.push_back("-d");
+            args.push_back(outDir + "/");
+        }
+        else
+        {
+            args.push_back("-o");
+            args.push_back(outDir + name);
+        }
+        size_t bytes = 0;
+        size_t end = std::min(classes.size(), i + perChunk);
+        for (; i < end && bytes < kMaxArgumentBytes; ++i)
+        {
+            args.push_back(classes[i]);
+            bytes += classes[i].size() + 1;
+        }
+        chunks.push_back(args);
+    }
+
+    Result result = { 0, 0, 0, 0 };
+    double start = Now();
+    size_t next = 0, running = 0;
+    while (next < chunks.size() || running > 0)
+    {
+        if (next < chunks.size() && running < jobs)
+        {
+            if (Spawn(chunks[next++], logPath) < 0)
+                Fail(string("unable to start jdep: ") + strerror(errno));
+            ++running;
+            continue;
+        }
+        int status;
+        struct rusage usage;
+        if (wait4(-1, &status, 0, &usage) < 0)
+            Fail(string("wait failed: ") + strerror(errno));
+        --running;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            Fail("jdep failed; see " + logPath);
+        result.cpu += Seconds(usage.ru_utime) + Seconds(usage.ru_stime);
+        result.peakRss = std::max(result.peakRss, usage.ru_maxrss);
+    }
+    result.wall = Now() - start;
+    ListFiles(outDir, &result.outputBytes);
+    return result;
+}
+
+struct WallOrder
+{
+    bool operator()(const Result& a, const Result& b) const { return a.wall < b.wall; }
+};
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    ParseArgs(argc, argv, options);
+    string dir = argv[0];
+
+    if (!options.generate && access(options.jdep.c_str(), X_OK) != 0)
+        Fail("no jdep at " + options.jdep + "; build it or use --jdep");
+
+    PrepareTree(dir, options.shape);
+    if (options.generate)
+        exit(0);
+    uint64_t treeBytes;
+    vector<string> files = ListFiles(dir + "/classes", &treeBytes);
+    vector<string> classes;
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        if (files[i].find('$') == string::npos)
+            classes.push_back(files[i]);
+    }
+
+    printf("# %s\n", options.shape.Describe().c_str());
+    printf("# %zu class files, %.1f MB; jdep %s -f %s\n", files.size(), treeBytes / 1e6,
+           options.jdep.c_str(), options.format.c_str());
+    printf("# cache\tjobs\tthreads\twall_s\tclasses_per_s\tcpu_s\tpeak_rss_kb\toutput_bytes\n");
+    fflush(stdout);
+
+    bool everyCache = true;
+    for (size_t c = 0; c < options.caches.size(); ++c)
+    {
+        bool cold = options.caches[c] == "cold";
+        for (size_t j = 0; j < options.jobs.size(); ++j)
+        {
+            for (size_t t = 0; t < options.threads.size(); ++t)
+            {
+                size_t jobs = options.jobs[j];
+                size_t threads = options.threads[t];
+                vector<Result> results;
+                if (!cold)
+                    RunJdep(options, dir, classes, jobs, threads);   // to warm the cache
+                for (size_t r = 0; r < options.repeat; ++r)
+                {
+                    if (cold)
+                        everyCache = EvictCache(files) && everyCache;
+                    results.push_back(RunJdep(options, dir, classes, jobs, threads));
+                }
+
+                std::sort(results.begin(), results.end(), WallOrder());
+                const Result& median = results[results.size() / 2];
+                printf("%s\t%zu\t%zu\t%.3f\t%.0f\t%.3f\t%ld\t%" PRIu64 "\n",
+                       options.caches[c].c_str(), jobs, threads, median.wall,
+                       classes.size() / median.wall, median.cpu, median.peakRss,
+                       median.outputBytes);
+                fflush(stdout);
+            }
+        }
+    }
+
+    RemoveTree(dir + "/out");
+    if (!everyCache)
+        printf("# cold runs dropped the tree's pages only: dropping every cache needs root\n");
+    exit(0);
+}
@@ -0,0 +1,181 @@
+#!/bin/bash
+
+# End-to-end checks of jdep on a small generated class tree, split over two
+# class roots. Each check prints "ok" or "FAILED"; the exit status is 1 if
+# any failed.
+#
+# usage: check.sh DIR    (with bin/jdep and bin/jdepbench built)
+
+BIN_DIR=$(dirname "$0")/bin
+JDEP=${JDEP:-$BIN_DIR/jdep}
+DIR=$1
+R1=$DIR/r1
+R2=$DIR/r2
+FAILED=0
+
+if [ -z "$DIR" ]; then
+    echo "usage: check.sh DIR" >&2
+    exit 2
+fi
+
+check()
+{
+    if "$@"; then
+        echo "ok      $1"
+    else
+        echo "FAILED  $1"
+        FAILED=1
+    fi
+}
+
+# The tree's packages alternate between the two roots
+rm -rf "$R1" "$R2"
+$BIN_DIR/jdepbench --classes 300 --generate "$DIR/tree" >/dev/null || exit 1
+mkdir -p "$R1/com/synth" "$R2/com/synth"
+ROOTS=("$R1" "$R2")
+ROOT=0
+for package in "$DIR"/tree/classes/com/synth/*; do
+    cp -r "$package" "${ROOTS[$ROOT]}/com/synth/"
+    ROOT=$((1 - ROOT))
+done
+FILES=$(find "$R1" "$R2" -name '*.class' ! -name '*$*' | sort)
+
+# Keys merged from shard graphs are the keys of one whole-tree run
+keys_merge_multi_root()
+{
+    local out=$DIR/keys
+    rm -rf "$out"
+    $JDEP -c "$R1:$R2" -d "$out/direct" --keys $FILES 2>/dev/null || return 1
+    for shard in 0 1; do
+        $JDEP -c "$R1:$R2" -f bin -o "$out/g$shard.bin" --shard $shard/2 $FILES 2>/dev/null || return 1
+    done
+    $JDEP -c "$R1:$R2" -d "$out/merged" -f tab -o "$out/merged.tab" \
+        --merge --keys "$out/g0.bin" "$out/g1.bin" || return 1
+    diff -r -x '*.d' "$out/direct" "$out/merged" >/dev/null
+}
+
+# A change to just an inner class's file changes its outer class's key
+keys_inner_class()
+{
+    local out=$DIR/keys
+    local inner=$(cd "$R2" && find com -name '*$*.class' | sort | head -1)
+    local outer=${inner%%\$*}
+    local before=$(cat "$out/direct/$outer.key")
+    printf '\0' >> "$R2/$inner"
+    $JDEP -c "$R1:$R2" -d "$out/changed" --keys $FILES 2>/dev/null || return 1
+    [ -n "$before" ] && [ "$before" != "$(cat "$out/changed/$outer.key")" ]
+}
+
+# Package dependencies of sharded runs come from merging their class graphs
+packages_from_shards()
+{
+    local out=$DIR/packages
+    rm -rf "$out"
+    mkdir -p "$out"
+    $JDEP -c "$R1:$R2" --packages 3 --shard 0/2 $FILES 2>/dev/null && return 1
+    $JDEP -c "$R1:$R2" -f tab -o "$out/direct.tab" --packages 3 $FILES 2>/dev/null || return 1
+    for shard in 0 1; do
+        $JDEP -c "$R1:$R2" -f bin -o "$out/g$shard.bin" --shard $shard/2 $FILES 2>/dev/null || return 1
+    done
+    $JDEP -f tab -o "$out/merged.tab" --merge --packages 3 "$out/g0.bin" "$out/g1.bin" || return 1
+    cmp -s "$out/direct.tab" "$out/merged.tab"
+}
+
+# An inner class is unreachable only if its outer class is too
+unreachable_inner_classes()
+{
+    local out=$DIR/unreachable
+    local all=$(find "$R1" "$R2" -name '*.class' | sort)
+    $JDEP -c "$R1:$R2" -o "$out" --root-annotation com.synth.annotation.Marker0 $all 2>/dev/null || return 1
+    [ -s "$out" ] || return 1
+    local class
+    for class in $(grep '\$' "$out"); do
+        grep -qx "${class%%\$*}" "$out" || return 1
+    done
+}
+
+# Writes a big-endian 16-bit value
+u16()
+{
+    printf "\\$(printf %03o $(($1 >> 8)))\\$(printf %03o $(($1 & 255)))"
+}
+
+# Writes a constant pool Utf8 entry
+utf8()
+{
+    printf '\1'; u16 ${#1}; printf %s "$1"
+}
+
+# Writes a class file for com/synth/NAME annotated with ATTRIBUTE holding
+# ANNOTATION, built from the constant pool entries below
+#   6 "Lcom/synth/Other;"  7 "value"  8 "Lcom/synth/Root;"  9 "X"
+annotated_class()
+{
+    local name=$1 attribute=$2 annotation=$3
+    printf '\312\376\272\276\0\0\0\64'; u16 10
+    utf8 "com/synth/$name"; printf '\7'; u16 1
+    utf8 java/lang/Object; printf '\7'; u16 3
+    utf8 "$attribute"; utf8 'Lcom/synth/Other;'; utf8 value; utf8 'Lcom/synth/Root;'; utf8 X
+    printf '\0\41'; u16 2; u16 4; u16 0; u16 0; u16 0
+    u16 1; u16 5; printf '\0\0'; u16 $(($(printf "$annotation" | wc -c) + 2)); u16 1
+    printf "$annotation"
+}
+
+# Only annotations on the class itself make it a root, not ones in their values
+root_annotation_top_level()
+{
+    local out=$DIR/annotations
+    rm -rf "$out"
+    mkdir -p "$out/com/synth"
+    # @Root, with each retention
+    annotated_class Direct RuntimeVisibleAnnotations '\0\10\0\0' > "$out/com/synth/Direct.class"
+    annotated_class Invisible RuntimeInvisibleAnnotations '\0\10\0\0' > "$out/com/synth/Invisible.class"
+    # @Other(value = Root.X) and @Other(value = @Root)
+    annotated_class Enum RuntimeVisibleAnnotations '\0\6\0\1\0\7e\0\10\0\11' > "$out/com/synth/Enum.class"
+    annotated_class Nested RuntimeVisibleAnnotations '\0\6\0\1\0\7@\0\10\0\0' > "$out/com/synth/Nested.class"
+    $JDEP -c "$out" -o "$out/unreachable" --root-annotation com.synth.Root \
+        "$out"/com/synth/*.class 2>/dev/null || return 1
+    [ "$(cat "$out/unreachable")" = "$(printf 'com/synth/Enum\ncom/synth/Nested')" ]
+}
+
+# A database holds every class's entry, and refuses shards that would race
+database_entries()
+{
+    local out=$DIR/db
+    rm -rf "$out"
+    $JDEP -c "$R1:$R2" -f tab -d "$out" --db tree --shard 0/2 $FILES 2>/dev/null && return 1
+    $JDEP -c "$R1:$R2" -f tab -d "$out" --db tree $FILES 2>/dev/null || return 1
+    $JDEP -c "$R1:$R2" -f tab -o "$out/merged.tab" $FILES 2>/dev/null || return 1
+    # Entries are in class order, merged output in FILE order
+    [ "$(cat "$out/jdep-tree.tab")" = "$(LC_ALL=C sort "$out/merged.tab")" ]
+}
+
+# A jar whose directory runs past its end, or that needs ZIP64, is refused
+corrupt_jars()
+{
+    local out=$DIR/jars
+    rm -rf "$out"
+    mkdir -p "$out"
+    # A central directory record claiming a 60000-byte name, then the end
+    # record: one entry, a 46-byte directory at offset 0
+    {
+        printf 'PK\1\2'; head -c 24 /dev/zero; printf '\140\352'; head -c 16 /dev/zero
+        printf 'PK\5\6\0\0\0\0\1\0\1\0\56\0\0\0\0\0\0\0\0\0'
+    } > "$out/long-name.jar"
+    $JDEP -c "$out/long-name.jar" $FILES 2>&1 | grep -q 'corrupt central directory' || return 1
+    head -c 40 "$out/long-name.jar" > "$out/truncated.jar"
+    $JDEP -c "$out/truncated.jar" $FILES 2>&1 | grep -q 'is not a jar file' || return 1
+    # An end record whose entry count says the real one is in a ZIP64 record
+    printf 'PK\5\6\0\0\0\0\377\377\377\377\0\0\0\0\0\0\0\0\0\0' > "$out/zip64.jar"
+    $JDEP -c "$out/zip64.jar" $FILES 2>&1 | grep -q 'ZIP64 jars are not supported'
+}
+
+check keys_merge_multi_root
+check keys_inner_class
+check packages_from_shards
+check unreachable_inner_classes
+check root_annotation_top_level
+check database_entries
+check corrupt_jars
+
+exit $FAILED
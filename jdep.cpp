@@ -28,11 +28,114 @@
   Written by Chip Morningstar.
 */
 
+#include <getopt.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <thread>
+
+#include "AnalysisPool.h"
 #include "ClassFileAnalyzer.h"
+#include "CompileSchedule.h"
+#include "DependencyGraph.h"
+#include "ExternalGraph.h"
+#include "HotspotReport.h"
+#include "IncrementalGraph.h"
+#include "Jobserver.h"
+#include "PackageGraph.h"
+#include "TraceLog.h"
+
+struct Options
+{
+    bool   merge;           // combine graph files rather than analyze class files
+    bool   hotspots;        // report rebuild hotspots rather than dependencies
+    bool   keys;            // write build cache keys beside the dependencies
+    bool   packages;        // write package dependencies rather than class ones
+    int    packageDepth;    // package components to roll classes up to, or 0 for all
+    bool   prune;           // report unreachable classes rather than dependencies
+    bool   database;        // gather per-class output into fragment files
+    size_t maxMemory;       // build the graph on disk within this budget, if set
+    int    jobs;            // analysis threads, or 0 to choose
+    int    scheduleWorkers; // plan a compile for this many workers, if set
+    string spillDir;        // where the on-disk graph goes
+    string componentsPath;  // where to write strongly connected components
+    string dependentsPath;  // where to write the reverse index
+    string graphPath;       // graph kept between runs, updated in place
+    string changesPath;     // where to report what an update changed
+    string deltaPath;       // where to write the edges each class gained and lost
+    string tracePath;       // where to write timed per-file events
+    vector<string> roots;   // classes named as roots of the reachable set
+
+    Options()
+        : merge(false)
+        , hotspots(false)
+        , keys(false)
+        , packages(false)
+        , packageDepth(0)
+        , prune(false)
+        , database(false)
+        , maxMemory(0)
+        , jobs(0)
+        , scheduleWorkers(0)
+    {
+        const char* tmp = getenv("TMPDIR");
+        spillDir = tmp && *tmp ? tmp : "/tmp";
+    }
+
+    bool WholeGraph() const
+    {
+        // Modes that need every class's dependencies before they finish
+        return hotspots || keys || prune;
+    }
+};
+
+enum
+{
+    kShardOption = 256,
+    kMergeOption,
+    kHotspotsOption,
+    kMaxMemoryOption,
+    kSpillDirOption,
+    kComponentsOption,
+    kDependentsOption,
+    kKeysOption,
+    kGraphOption,
+    kChangesOption,
+    kJobsOption,
+    kPackagesOption,
+    kDeltaOption,
+    kRootOption,
+    kRootAnnotationOption,
+    kScheduleOption,
+    kDbOption,
+    kTraceOption
+};
+
+const struct option kLongOptions[] =
+{
+    { "shard",    required_argument, 0, kShardOption },
+    { "merge",    no_argument,       0, kMergeOption },
+    { "hotspots", no_argument,       0, kHotspotsOption },
+    { "max-memory", required_argument, 0, kMaxMemoryOption },
+    { "spill-dir",  required_argument, 0, kSpillDirOption },
+    { "components", required_argument, 0, kComponentsOption },
+    { "dependents", required_argument, 0, kDependentsOption },
+    { "keys",       no_argument,       0, kKeysOption },
+    { "graph",      required_argument, 0, kGraphOption },
+    { "changes",    required_argument, 0, kChangesOption },
+    { "jobs",       required_argument, 0, kJobsOption },
+    { "packages",   required_argument, 0, kPackagesOption },
+    { "delta",      required_argument, 0, kDeltaOption },
+    { "root",       required_argument, 0, kRootOption },
+    { "root-annotation", required_argument, 0, kRootAnnotationOption },
+    { "schedule",   required_argument, 0, kScheduleOption },
+    { "db",         required_argument, 0, kDbOption },
+    { "trace",      required_argument, 0, kTraceOption },
+    { 0, 0, 0, 0 }
+};
 
 void Usage()
 {
@@ -45,18 +148,59 @@ void Usage()
     printf("-i PACKAGE  Include PACKAGE in dependencies\n");
     printf("-h          Print this helpful help message\n");
     printf("-d DPATH    Use DPATH as base directory for output .d files\n");
-    printf("-c CPATH    Use CPATH as base directory for .class files\n");
-    printf("-j JPATH    Use JPATH as base directory for .java files in dependency lines\n");
-    printf("file        Name of a class file to examine\n");
+    printf("-c CPATH    Add CPATH (dirs and jars, colon separated) to the .class search path\n");
+    printf("-j JPATH    Add JPATH (dirs and jars, colon separated) to the .java search path\n");
+    printf("-f FORMAT   Write output as d (make rules), tab (class<TAB>dep) or bin (graph)\n");
+    printf("-m          Merge all output onto stdout instead of one file per class\n");
+    printf("-o FILE     Merge all output into FILE\n");
+    printf("--shard I/N Only analyze the classes in shard I of N (0 <= I < N)\n");
+    printf("--merge     Combine tab or bin graph files into one graph\n");
+    printf("--hotspots  Rank classes by the rebuild cost of changing them\n");
+    printf("--max-memory SIZE  Build the whole graph on disk, with SIZE (K, M or G) of heap buffers (mapped graph pages not counted)\n");
+    printf("--spill-dir DIR    Put the on-disk graph in DIR (default $TMPDIR or /tmp)\n");
+    printf("--components FILE  Write each class's strongly connected component to FILE (with --max-memory)\n");
+    printf("--dependents FILE  Write the classes depending on each class to FILE (with --max-memory)\n");
+    printf("--keys      Also write a transitive build cache key for each class to a .key file\n");
+    printf("--graph STATE      Update the graph in STATE from just the changed class files given\n");
+    printf("--changes FILE     Report the outputs and compile groups the update changed (with --graph)\n");
+    printf("--jobs N    Analyze on up to N threads, taking tokens from make's jobserver if there is one\n");
+    printf("--packages DEPTH   Write weighted package dependencies, packages cut to DEPTH components (0 = whole)\n");
+    printf("--delta FILE       Write the edges each class gained or lost since its last output (or STATE) to FILE\n");
+    printf("--root CLASS       List the analyzed classes not reachable from CLASS (repeatable)\n");
+    printf("--root-annotation ANNOTATION  Also treat classes annotated with ANNOTATION as roots\n");
+    printf("--schedule N       Plan parallel javac batches for N workers to rebuild the stale FILEs (with --graph)\n");
+    printf("--db SCOPE  Keep per-class output as entries in one file per package or for the whole tree\n");
+    printf("--trace FILE       Write when each file's open, read, parse and output began and ended, per thread, to FILE\n");
+    printf("file        Name of a class file to examine (or graph file, with --merge)\n");
     exit(0);
 }
 
-void ParseArgs(int& argc, char**& argv, ClassFileAnalyzer& analyzer)
+void Fail(const string& message)
+{
+    fprintf(stderr, "%s\n", message.c_str());
+    exit(1);
+}
+
+bool ParseSize(const char* text, size_t& size)
+{
+    char* end;
+    unsigned long long value = strtoull(text, &end, 10);
+    switch (*end)
+    {
+        case 'g': case 'G': value <<= 10;   // fall through
+        case 'm': case 'M': value <<= 10;   // fall through
+        case 'k': case 'K': value <<= 10; ++end; break;
+    }
+    size = value;
+    return end != text && *end == '\0' && value > 0;
+}
+
+void ParseArgs(int& argc, char**& argv, ClassFileAnalyzer& analyzer, Options& options)
 {
     bool excludeLibraryPackages = true;
     while (true)
     {
-        int c = getopt(argc, argv, "ae:i:c:d:j:f:m");
+        int c = getopt_long(argc, argv, "ae:i:c:d:j:f:mo:", kLongOptions, 0);
         if (c == -1)
             break;
 
@@ -79,7 +223,8 @@ void ParseArgs(int& argc, char**& argv, ClassFileAnalyzer& analyzer)
             }
             case 'c':
             {
-                analyzer.SetClassRoot(optarg);
+                if (!analyzer.AddClassRoots(optarg))
+                    Fail(analyzer.Error());
                 break;
             }
             case 'd':
@@ -89,12 +234,17 @@ void ParseArgs(int& argc, char**& argv, ClassFileAnalyzer& analyzer)
             }
             case 'j':
             {
-                analyzer.SetJavaRoot(optarg);
+                if (!analyzer.AddJavaRoots(optarg))
+                    Fail(analyzer.Error());
                 break;
             }
             case 'f':
             {
-                analyzer.SetFormat(optarg);
+                if (!analyzer.SetFormat(optarg))
+                {
+                    fprintf(stderr, "Format %s unrecognized.\n", optarg);
+                    exit(1);
+                }
                 break;
             }
             case 'm':
@@ -102,6 +252,138 @@ void ParseArgs(int& argc, char**& argv, ClassFileAnalyzer& analyzer)
                 analyzer.MergeOutput();
                 break;
             }
+            case 'o':
+            {
+                analyzer.SetOutputFile(optarg);
+                break;
+            }
+            case kShardOption:
+            {
+                int index, count;
+                if (sscanf(optarg, "%d/%d", &index, &count) != 2 || !analyzer.SetShard(index, count))
+                {
+                    fprintf(stderr, "Shard %s should be I/N with 0 <= I < N.\n", optarg);
+                    exit(1);
+                }
+                break;
+            }
+            case kMergeOption:
+            {
+                options.merge = true;
+                break;
+            }
+            case kHotspotsOption:
+            {
+                options.hotspots = true;
+                break;
+            }
+            case kMaxMemoryOption:
+            {
+                if (!ParseSize(optarg, options.maxMemory))
+                {
+                    fprintf(stderr, "Memory size %s should be a number of bytes, K, M or G.\n", optarg);
+                    exit(1);
+                }
+                break;
+            }
+            case kSpillDirOption:
+            {
+                options.spillDir = optarg;
+                break;
+            }
+            case kComponentsOption:
+            {
+                options.componentsPath = optarg;
+                break;
+            }
+            case kDependentsOption:
+            {
+                options.dependentsPath = optarg;
+                break;
+            }
+            case kKeysOption:
+            {
+                options.keys = true;
+                break;
+            }
+            case kGraphOption:
+            {
+                options.graphPath = optarg;
+                break;
+            }
+            case kChangesOption:
+            {
+                options.changesPath = optarg;
+                break;
+            }
+            case kJobsOption:
+            {
+                char* end;
+                options.jobs = strtol(optarg, &end, 10);
+                if (end == optarg || *end != '\0' || options.jobs < 1)
+                {
+                    fprintf(stderr, "Job count %s should be a positive number.\n", optarg);
+                    exit(1);
+                }
+                break;
+            }
+            case kPackagesOption:
+            {
+                char* end;
+                options.packages = true;
+                options.packageDepth = strtol(optarg, &end, 10);
+                if (end == optarg || *end != '\0' || options.packageDepth < 0)
+                {
+                    fprintf(stderr, "Package depth %s should be a number, 0 for whole packages.\n", optarg);
+                    exit(1);
+                }
+                break;
+            }
+            case kDeltaOption:
+            {
+                options.deltaPath = optarg;
+                break;
+            }
+            case kRootOption:
+            {
+                string root(optarg);
+                std::replace(root.begin(), root.end(), '.', '/');
+                options.roots.push_back(root);
+                options.prune = true;
+                break;
+            }
+            case kRootAnnotationOption:
+            {
+                analyzer.AddRootAnnotation(optarg);
+                options.prune = true;
+                break;
+            }
+            case kScheduleOption:
+            {
+                char* end;
+                options.scheduleWorkers = strtol(optarg, &end, 10);
+                if (end == optarg || *end != '\0' || options.scheduleWorkers < 1)
+                {
+                    fprintf(stderr, "Worker count %s should be a positive number.\n", optarg);
+                    exit(1);
+                }
+                break;
+            }
+            case kDbOption:
+            {
+                if (!analyzer.SetDatabase(optarg))
+                {
+                    fprintf(stderr, "Database scope %s should be package or tree.\n", optarg);
+                    exit(1);
+                }
+                options.database = true;
+                break;
+            }
+            case kTraceOption:
+            {
+                options.tracePath = optarg;
+                break;
+            }
             default:
             {
                 Usage();
@@ -110,6 +392,61 @@ void ParseArgs(int& argc, char**& argv, ClassFileAnalyzer& analyzer)
         }
     }
 
+    if (!options.maxMemory && !(options.componentsPath.empty() && options.dependentsPath.empty()))
+        Fail("--components and --dependents need --max-memory");
+    if (options.maxMemory && options.hotspots)
+        Fail("--hotspots needs the graph in memory, so cannot be used with --max-memory");
+    if (options.maxMemory && options.keys)
+        Fail("--keys needs the graph in memory, so cannot be used with --max-memory");
+    if (options.keys && analyzer.ShardCount() > 1)
+        Fail("--keys needs the whole tree: run the shards without it, then --merge --keys");
+    if (options.packages && (options.hotspots || options.keys || options.maxMemory))
+        Fail("--packages cannot be combined with --hotspots, --keys or --max-memory");
+    if (options.packages && analyzer.ShardCount() > 1)
+        Fail("--packages output cannot be merged: run the shards without it, then --merge --packages");
+    if (options.prune && (options.hotspots || options.keys || options.packages
+                          || options.maxMemory || !options.deltaPath.empty()))
+        Fail("--root cannot be combined with --hotspots, --keys, --packages, --max-memory or --delta");
+    if (options.merge && options.prune && options.roots.empty())
+        Fail("--root-annotation needs the class files, so cannot be used with --merge; name the roots with --root");
+    if (!options.deltaPath.empty())
+    {
+        if (options.merge || options.hotspots || options.packages || options.maxMemory)
+            Fail("--delta cannot be combined with --merge, --hotspots, --packages or --max-memory");
+        if (!analyzer.WritesPerClassFiles())
+            Fail("--delta compares against the output file of each class, so cannot be combined with -m, -o or -f bin");
+    }
+    if (options.database)
+    {
+        if (options.merge || options.hotspots || options.packages || options.prune
+            || options.maxMemory || options.scheduleWorkers)
+            Fail("--db cannot be combined with --merge, --hotspots, --packages, --root, --max-memory or --schedule");
+        if (analyzer.ShardCount() > 1)
+            Fail("--db rewrites whole fragments, which shards running at once would overwrite, so cannot be combined with --shard");
+        if (!analyzer.WritesPerClassFiles())
+            Fail("--db gathers the output of each class, so cannot be combined with -m, -o or -f bin");
+        if (!options.deltaPath.empty() && options.graphPath.empty())
+            Fail("--delta compares against the output file of each class, so needs --graph with --db");
+    }
+    if (options.scheduleWorkers)
+    {
+        if (options.graphPath.empty())
+            Fail("--schedule plans from the graph the last build left, so needs --graph");
+        if (options.merge || options.hotspots || options.keys || options.packages || options.prune
+            || options.maxMemory || !options.changesPath.empty() || !options.deltaPath.empty())
+            Fail("--schedule cannot be combined with --merge, --hotspots, --keys, --packages, --root, --max-memory, --changes or --delta");
+    }
+    else if (options.graphPath.empty() && !options.changesPath.empty())
+        Fail("--changes needs --graph");
+    if (!options.graphPath.empty() && !options.scheduleWorkers)
+    {
+        if (options.merge || options.hotspots || options.keys || options.packages || options.prune
+            || options.maxMemory || analyzer.ShardCount() > 1)
+            Fail("--graph cannot be combined with --merge, --hotspots, --keys, --packages, --root, --max-memory or --shard");
+        if (!analyzer.WritesPerClassFiles())
+            Fail("--graph updates one output file per class, so cannot be combined with -m, -o or -f bin");
+    }
+
     if (excludeLibraryPackages)
     {
         analyzer.excludePackage("java");
@@ -121,16 +458,352 @@ void ParseArgs(int& argc, char**& argv, ClassFileAnalyzer& analyzer)
     argv += optind;
 }
 
+template <typename Graph>
+void ReadGraphs(int argc, char* argv[], Graph& graph)
+{
+    for (int i = 0; i < argc; ++i)
+    {
+        if (!graph.Read(argv[i]))
+            Fail(graph.Error());
+    }
+}
+
+int ThreadCount(const Options& options, bool jobserver)
+{
+    // Under a jobserver its tokens decide how many threads actually run, so
+    // offer one per core; otherwise stay single-threaded unless told.
+    if (options.jobs)
+        return options.jobs;
+    if (!jobserver)
+        return 1;
+    unsigned cores = std::thread::hardware_concurrency();
+    return cores ? cores : 1;
+}
+
+void FailAnalysis(AnalysisPool& pool, const string& message)
+{
+    // Let the workers give back their tokens, or make loses the slots
+    pool.Stop();
+    Fail(message);
+}
+
+void WriteDelta(FILE* outFile, const string& name,
+                const vector<string>& removed, const vector<string>& added)
+{
+    for (size_t i = 0; i < removed.size(); ++i)
+        fprintf(outFile, "-\t%s\t%s\n", name.c_str(), removed[i].c_str());
+    for (size_t i = 0; i < added.size(); ++i)
+        fprintf(outFile, "+\t%s\t%s\n", name.c_str(), added[i].c_str());
+}
+
+void AnalyzeFiles(int argc, char* argv[], ClassFileAnalyzer& analyzer, AnalysisPool& pool,
+                  GraphSink* graph, bool writeOutput, FILE* deltaFile, vector<string>* roots)
+{
+    analyzer.IndexClassPath();
+    analyzer.SetTrace(stderr);
+
+    vector<string> files;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (analyzer.InShard(argv[i]))
+            files.push_back(argv[i]);
+    }
+
+    vector<string> removed, added;
+    pool.Start(files);
+    while (pool.Next(analyzer))
+    {
+        if (!analyzer.Error().empty())
+            FailAnalysis(pool, analyzer.Error());
+        if (graph)
+            analyzer.AddToGraph(*graph);
+        if (roots && analyzer.IsRoot())
+            roots->push_back(analyzer.PackageAndName());
+        if (deltaFile)
+        {
+            if (!analyzer.OutputDelta(removed, added))
+                FailAnalysis(pool, analyzer.Error());
+            WriteDelta(deltaFile, analyzer.PackageAndName(), removed, added);
+        }
+        if (writeOutput && !analyzer.WriteOutput())
+            FailAnalysis(pool, analyzer.Error());
+    }
+    pool.Stop();
+}
+
+void WriteUnreachable(ClassFileAnalyzer& analyzer, DependencyGraph& graph,
+                      const vector<string>& roots)
+{
+    // An empty or mistyped root would report everything as unused
+    if (roots.empty())
+        Fail("no class was found to be a root");
+    vector<DependencyGraph::NodeId> nodes(roots.size());
+    for (size_t i = 0; i < roots.size(); ++i)
+    {
+        if (!graph.Find(roots[i], nodes[i]))
+            Fail("root class " + roots[i] + " is not in the graph");
+    }
+
+    graph.Canonicalize();
+    for (size_t i = 0; i < roots.size(); ++i)
+        graph.Find(roots[i], nodes[i]);
+
+    // No edge names an inner class, since dependencies on one are recorded
+    // against its outer class, and an inner class cannot be loaded without
+    // its outer one: they are reachable together.
+    vector<DependencyGraph::NodeId> outers(graph.NodeCount());
+    for (DependencyGraph::NodeId node = 0; node < graph.NodeCount(); ++node)
+    {
+        string name = graph.Name(node);
+        size_t dollar = name.find('$');
+        if (dollar == string::npos || !graph.Find(name.substr(0, dollar), outers[node]))
+            outers[node] = node;
+    }
+    for (size_t i = 0, count = nodes.size(); i < count; ++i)
+        nodes.push_back(outers[nodes[i]]);
+    vector<bool> reached;
+    graph.Reachable(nodes, reached);
+
+    FILE* outFile = analyzer.MergedOutput();
+    if (!outFile)
+        Fail(analyzer.Error());
+    for (DependencyGraph::NodeId node = 0; node < graph.NodeCount(); ++node)
+    {
+        if (graph.IsAnalyzed(node) && !reached[node] && !reached[outers[node]])
+            fprintf(outFile, "%s\n", graph.Name(node).c_str());
+    }
+}
+
+void WriteFile(const string& path, const ExternalGraph& graph,
+               void (ExternalGraph::*write)(FILE*) const)
+{
+    FILE* outFile = fopen(path.c_str(), "wb");
+    if (!outFile)
+        Fail("unable to open output file " + path);
+    (graph.*write)(outFile);
+    if (fclose(outFile) != 0)
+        Fail("error writing output file " + path);
+}
+
+void BuildExternalGraph(int argc, char* argv[], ClassFileAnalyzer& analyzer, AnalysisPool& pool,
+                        const Options& options)
+{
+    ExternalGraph graph(options.spillDir, options.maxMemory);
+    if (options.merge)
+        ReadGraphs(argc, argv, graph);
+    else
+        AnalyzeFiles(argc, argv, analyzer, pool, &graph, false, 0, 0);
+
+    if (!graph.Build())
+        Fail(graph.Error());
+    if (!analyzer.WriteGraph(graph))
+        Fail(analyzer.Error());
+    if (!options.componentsPath.empty())
+        WriteFile(options.componentsPath, graph, &ExternalGraph::WriteComponents);
+    if (!options.dependentsPath.empty())
+        WriteFile(options.dependentsPath, graph, &ExternalGraph::WriteDependents);
+}
+
+void WriteChanges(const string& path, const IncrementalGraph& graph, ClassFileAnalyzer& analyzer)
+{
+    FILE* outFile = fopen(path.c_str(), "w");
+    if (!outFile)
+        Fail("unable to open output file " + path);
+
+    const vector<string>& changed = graph.ChangedClasses();
+    for (size_t i = 0; i < changed.size(); ++i)
+        fprintf(outFile, "changed\t%s\n", analyzer.OutputPath(changed[i]).c_str());
+    const vector<string>& removed = graph.RemovedClasses();
+    for (size_t i = 0; i < removed.size(); ++i)
+        fprintf(outFile, "removed\t%s\n", analyzer.OutputPath(removed[i]).c_str());
+
+    vector<vector<string> > groups = graph.ChangedGroups();
+    for (size_t g = 0; g < groups.size(); ++g)
+    {
+        fprintf(outFile, "group\t");
+        for (size_t i = 0; i < groups[g].size(); ++i)
+            fprintf(outFile, "%s%s", i ? " " : "", groups[g][i].c_str());
+        fprintf(outFile, "\n");
+    }
+
+    if (fclose(outFile) != 0)
+        Fail("error writing output file " + path);
+}
+
+void UpdateGraph(int argc, char* argv[], ClassFileAnalyzer& analyzer, AnalysisPool& pool,
+                 const Options& options, FILE* deltaFile)
+{
+    IncrementalGraph graph;
+    if (!graph.Load(options.graphPath))
+        Fail(graph.Error());
+
+    analyzer.IndexClassPath();
+    analyzer.SetTrace(stderr);
+
+    // Only classes whose dependencies changed get their output rewritten, so
+    // that make sees nothing new for the rest. A FILE that no longer exists
+    // is a class that was deleted.
+    vector<string> files;
+    for (int i = 0; i < argc; ++i)
+    {
+        string name = analyzer.PackageAndNameOf(argv[i]);
+        if (analyzer.HasClassFile(name))
+        {
+            files.push_back(argv[i]);
+            continue;
+        }
+        graph.RemoveClass(name);
+        if (graph.LastChanged() && !analyzer.RemoveOutput(name))
+            Fail(analyzer.Error());
+        if (deltaFile)
+            WriteDelta(deltaFile, name, graph.LastRemoved(), graph.LastAdded());
+    }
+
+    pool.Start(files);
+    while (pool.Next(analyzer))
+    {
+        if (!analyzer.Error().empty())
+            FailAnalysis(pool, analyzer.Error());
+        analyzer.AddToGraph(graph);
+        if (graph.LastChanged() && !analyzer.WriteOutput())
+            FailAnalysis(pool, analyzer.Error());
+        if (deltaFile)
+            WriteDelta(deltaFile, analyzer.PackageAndName(), graph.LastRemoved(), graph.LastAdded());
+    }
+    pool.Stop();
+
+    graph.Update();
+    if (!options.changesPath.empty())
+        WriteChanges(options.changesPath, graph, analyzer);
+    if (!graph.Save(options.graphPath))
+        Fail(graph.Error());
+}
+
+void PlanSchedule(int argc, char* argv[], ClassFileAnalyzer& analyzer, const Options& options)
+{
+    // Only read: the graph is brought up to date after the compile
+    IncrementalGraph graph;
+    if (!graph.Load(options.graphPath))
+        Fail(graph.Error());
+
+    // javac compiles an inner class with its outer class
+    analyzer.IndexClassPath();
+    vector<string> stale;
+    for (int i = 0; i < argc; ++i)
+    {
+        string name = analyzer.PackageAndNameOf(argv[i]);
+        stale.push_back(name.substr(0, name.find('$')));
+    }
+    CompileSchedule schedule(graph.Graph(), stale, options.scheduleWorkers);
+
+    FILE* outFile = analyzer.MergedOutput();
+    if (!outFile)
+        Fail(analyzer.Error());
+    const vector<CompileSchedule::Batch>& batches = schedule.Batches();
+    for (size_t b = 0; b < batches.size(); ++b)
+    {
+        const CompileSchedule::Batch& batch = batches[b];
+        fprintf(outFile, "batch\t%u\t%u\t%" PRIu64 "\t", batch.level, batch.worker, batch.cost);
+        for (size_t i = 0; i < batch.classes.size(); ++i)
+            fprintf(outFile, "%s%s", i ? " " : "", analyzer.SourcePathFor(batch.classes[i]).c_str());
+        fprintf(outFile, "\n");
+    }
+    const vector<string>& critical = schedule.CriticalPath();
+    fprintf(outFile, "critical\t%" PRIu64 "\t", schedule.CriticalCost());
+    for (size_t i = 0; i < critical.size(); ++i)
+        fprintf(outFile, "%s%s", i ? " " : "", analyzer.SourcePathFor(critical[i]).c_str());
+    fprintf(outFile, "\n");
+}
+
 int main(int argc, char* argv[])
 {
     ClassFileAnalyzer analyzer;
+    Options options;
+    DependencyGraph graph;
 
-    ParseArgs(argc, argv, analyzer);
+    ParseArgs(argc, argv, analyzer, options);
 
-    for (int i = 0; i < argc; ++i)
+    Jobserver jobserver;
+    const char* makeflags = getenv("MAKEFLAGS");
+    bool shared = makeflags && jobserver.Connect(makeflags);
+    AnalysisPool pool(analyzer, ThreadCount(options, shared), shared ? &jobserver : 0);
+
+    FILE* deltaFile = 0;
+    if (!options.deltaPath.empty() && !(deltaFile = fopen(options.deltaPath.c_str(), "w")))
+        Fail("unable to open output file " + options.deltaPath);
+
+    // Opened now so that a bad path fails before the run rather than after
+    TraceLog trace;
+    FILE* traceFile = 0;
+    if (!options.tracePath.empty())
+    {
+        if (!(traceFile = fopen(options.tracePath.c_str(), "w")))
+            Fail("unable to open output file " + options.tracePath);
+        analyzer.SetTraceLog(&trace);
+    }
+
+    if (options.scheduleWorkers)
+        PlanSchedule(argc, argv, analyzer, options);
+    else if (options.maxMemory)
+        BuildExternalGraph(argc, argv, analyzer, pool, options);
+    else if (!options.graphPath.empty())
+        UpdateGraph(argc, argv, analyzer, pool, options, deltaFile);
+    else
+    {
+        // Packages are rolled up as classes are analyzed, with no class graph
+        PackageGraph packages(options.packageDepth);
+        GraphSink* sink = options.packages ? (GraphSink*) &packages
+                        : options.WholeGraph() ? &graph : 0;
+        vector<string> roots(options.roots);
+        if (options.merge)
+            ReadGraphs(argc, argv, graph);
+        else
+            AnalyzeFiles(argc, argv, analyzer, pool, sink,
+                         !options.hotspots && !options.packages && !options.prune,
+                         deltaFile, &roots);
+
+        if (options.prune)
+            WriteUnreachable(analyzer, graph, roots);
+        else if (options.packages)
+        {
+            if (options.merge)
+                packages.AddGraph(graph);
+            if (!analyzer.WritePackages(packages))
+                Fail(analyzer.Error());
+        }
+        else if (options.hotspots)
+        {
+            FILE* outFile = analyzer.MergedOutput();
+            if (!outFile)
+                Fail(analyzer.Error());
+            HotspotReport(graph).Write(outFile);
+        }
+        else if (options.merge)
+        {
+            if (!analyzer.WriteGraph(graph))
+                Fail(analyzer.Error());
+        }
+
+        if (options.keys)
+        {
+            // Analysis indexes the class path; keys read from it either way
+            if (options.merge)
+                analyzer.IndexClassPath();
+            if (!analyzer.WriteKeys(graph))
+                Fail(analyzer.Error());
+        }
+    }
+
+    if (!analyzer.FinishOutput())
+        Fail(analyzer.Error());
+    if (deltaFile && fclose(deltaFile) != 0)
+        Fail("error writing output file " + options.deltaPath);
+    if (traceFile)
     {
-        analyzer.analyzeClassFile(argv[i]);
-        analyzer.WriteOutput();
+        pool.Stop();
+        trace.Write(traceFile);
+        if (fclose(traceFile) != 0)
+            Fail("error writing output file " + options.tracePath);
     }
 
     exit(0);
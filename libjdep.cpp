@@ -0,0 +1,142 @@
+// libjdep.cpp
+
+#include "libjdep.h"
+
+#include "ClassFile.h"
+#include "ClassFileAnalyzer.h"
+#include "ClassFileVisitor.h"
+
+// Adapts a C callback table to ClassFileVisitor.
+class CallbackVisitor : public ClassFileVisitor
+{
+public:
+    CallbackVisitor(const jdep_callbacks* callbacks, void* context)
+        : mCallbacks(callbacks)
+        , mContext(context)
+    {}
+
+    virtual void visitDependency(const char* name)
+    {
+        if (mCallbacks->dependency)
+            mCallbacks->dependency(mContext, name);
+    }
+
+    virtual void visitInnerClass(const char* name)
+    {
+        if (mCallbacks->inner_class)
+            mCallbacks->inner_class(mContext, name);
+    }
+
+    virtual void visitAnnotation(const char* name)
+    {
+        if (mCallbacks->annotation)
+            mCallbacks->annotation(mContext, name);
+    }
+
+private:
+    const jdep_callbacks* mCallbacks;
+    void*                 mContext;
+};
+
+struct jdep_class
+{
+    ClassFile file;
+    string    name;
+
+    jdep_class(const char* path)
+        : file(path)
+    {}
+
+    jdep_class(const char* _name, const void* bytes, size_t length)
+        : file(_name, (const uint8_t*) bytes, length)
+        , name(_name)
+    {}
+};
+
+struct jdep_analyzer
+{
+    ClassFileAnalyzer analyzer;
+};
+
+jdep_class* jdep_class_open(const char* path)
+{
+    jdep_class* cls = new jdep_class(path);
+    if (cls->file.Name())
+        cls->name = cls->file.Name();
+    return cls;
+}
+
+jdep_class* jdep_class_open_buffer(const char* name, const void* bytes, size_t length)
+{
+    return new jdep_class(name, bytes, length);
+}
+
+const char* jdep_class_error(const jdep_class* cls)
+{
+    return cls->file.Ok() ? NULL : cls->file.Error().c_str();
+}
+
+int jdep_class_visit(jdep_class* cls, const jdep_callbacks* callbacks, void* context)
+{
+    if (!cls->file.Ok())
+        return -1;
+    CallbackVisitor visitor(callbacks, context);
+    cls->file.findDepsInFile(cls->name.c_str(), visitor);
+    return 0;
+}
+
+void jdep_class_close(jdep_class* cls)
+{
+    delete cls;
+}
+
+jdep_analyzer* jdep_analyzer_new(void)
+{
+    return new jdep_analyzer;
+}
+
+void jdep_analyzer_free(jdep_analyzer* analyzer)
+{
+    delete analyzer;
+}
+
+const char* jdep_analyzer_error(const jdep_analyzer* analyzer)
+{
+    const string& error = analyzer->analyzer.Error();
+    return error.empty() ? NULL : error.c_str();
+}
+
+int jdep_analyzer_add_class_roots(jdep_analyzer* analyzer, const char* roots)
+{
+    return analyzer->analyzer.AddClassRoots(roots) ? 0 : -1;
+}
+
+int jdep_analyzer_add_java_roots(jdep_analyzer* analyzer, const char* roots)
+{
+    return analyzer->analyzer.AddJavaRoots(roots) ? 0 : -1;
+}
+
+void jdep_analyzer_include_package(jdep_analyzer* analyzer, const char* package)
+{
+    analyzer->analyzer.includePackage(package);
+}
+
+void jdep_analyzer_exclude_package(jdep_analyzer* analyzer, const char* package)
+{
+    analyzer->analyzer.excludePackage(package);
+}
+
+void jdep_analyzer_index(jdep_analyzer* analyzer)
+{
+    analyzer->analyzer.IndexClassPath();
+}
+
+int jdep_analyzer_analyze(jdep_analyzer* analyzer, const char* class_file,
+                          const jdep_callbacks* callbacks, void* context)
+{
+    CallbackVisitor visitor(callbacks, context);
+    analyzer->analyzer.SetVisitor(&visitor);
+    bool ok = analyzer->analyzer.analyzeClassFile(class_file);
+    analyzer->analyzer.SetVisitor(0);
+    return ok ? 0 : -1;
+}
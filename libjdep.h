@@ -0,0 +1,80 @@
+/*
+  libjdep.h -- C interface to the jdep class file dependency analyzer
+
+  Nothing in this library calls exit() or writes to stderr. Functions that can
+  fail return 0 on success and -1 on failure, with a description available
+  from the matching *_error() function until the next call on that object.
+
+  Class names are package paths such as com/fudco/jdepexample/pack1/Foo. Names
+  passed to callbacks are only valid for the duration of the callback.
+*/
+
+#ifndef LIBJDEP_H
+#define LIBJDEP_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct jdep_callbacks
+{
+    /* A class the file depends on. References to another class's inner
+       class arrive as a dependency on its outer class. */
+    void (*dependency)(void* context, const char* name);
+
+    /* One of the class's own inner classes. */
+    void (*inner_class)(void* context, const char* name);
+
+    /* An annotation type, or an enum type used in an annotation. */
+    void (*annotation)(void* context, const char* name);
+} jdep_callbacks;
+
+/* A single parsed class file. Callbacks left NULL are not called. */
+typedef struct jdep_class jdep_class;
+
+jdep_class* jdep_class_open(const char* path);
+jdep_class* jdep_class_open_buffer(const char* name, const void* bytes, size_t length);
+/* Both return a handle even on failure; check jdep_class_error(). name is the
+   class's package path. The buffer may be freed as soon as this returns. */
+
+const char* jdep_class_error(const jdep_class* cls);
+/* NULL if the class file was read successfully. */
+
+int jdep_class_visit(jdep_class* cls, const jdep_callbacks* callbacks, void* context);
+/* Reports the class's raw dependencies, without package filtering or inner
+   class recursion. */
+
+void jdep_class_close(jdep_class* cls);
+
+/* The analyzer jdep itself uses: package filters, class and source search
+   paths, and recursion into inner classes. */
+typedef struct jdep_analyzer jdep_analyzer;
+
+jdep_analyzer* jdep_analyzer_new(void);
+void jdep_analyzer_free(jdep_analyzer* analyzer);
+
+const char* jdep_analyzer_error(const jdep_analyzer* analyzer);
+
+int jdep_analyzer_add_class_roots(jdep_analyzer* analyzer, const char* roots);
+int jdep_analyzer_add_java_roots(jdep_analyzer* analyzer, const char* roots);
+/* roots is a colon-separated list of directories and .jar files. */
+
+void jdep_analyzer_include_package(jdep_analyzer* analyzer, const char* package);
+void jdep_analyzer_exclude_package(jdep_analyzer* analyzer, const char* package);
+/* package is dotted or slashed, e.g. "java.lang" or "java/lang". */
+
+void jdep_analyzer_index(jdep_analyzer* analyzer);
+/* Call once all roots are added, before the first analyze. */
+
+int jdep_analyzer_analyze(jdep_analyzer* analyzer, const char* class_file,
+                          const jdep_callbacks* callbacks, void* context);
+/* Analyzes class_file and its inner classes, streaming each distinct
+   dependency that passes the package filters to callbacks. */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBJDEP_H */